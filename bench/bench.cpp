@@ -0,0 +1,85 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#include "bench.h"
+
+/*
+ * The allocator is interposed for the whole process, libsystemd and
+ * ncurses allocations are counted along with ours
+ */
+extern "C" {
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t count, size_t size);
+  void *__libc_realloc(void *pointer, size_t size);
+}
+
+static std::atomic<unsigned long> allocations(0);
+
+extern "C" void *malloc(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(pointer, size);
+}
+
+unsigned long benchAllocations() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+void benchHeader() {
+  fprintf(stdout, "name\tsize\truns\tp50_ms\tp90_ms\tp99_ms\tmax_ms\tallocs\n");
+}
+
+/*
+ * A single run, for measurements that consume their input
+ */
+void benchReport(const char *name, size_t size, const BenchMark &since) {
+  std::vector<double> samples(1, benchElapsed(since));
+
+  benchReport(name, size, &samples, benchAllocations() - since.allocations);
+}
+
+static double percentile(const std::vector<double> &sorted, int rank) {
+  size_t at = (sorted.size() * rank + 99) / 100;
+
+  return sorted[at == 0 ? 0 : at - 1];
+}
+
+void benchReport(const char *name, size_t size, std::vector<double> *samples,
+    unsigned long allocations) {
+  std::sort(samples->begin(), samples->end());
+
+  fprintf(stdout, "%s\t%zu\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\t%lu\n", name, size,
+      samples->size(), percentile(*samples, 50), percentile(*samples, 90),
+      percentile(*samples, 99), samples->back(), allocations);
+  fflush(stdout);
+}
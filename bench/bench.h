@@ -0,0 +1,84 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHK_BENCH_H
+#define _CHK_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Minimal timing helpers shared by the benchmarks.
+ * Every measurement is printed as one tab separated line: name, dataset
+ * size, runs, p50/p90/p99/max milliseconds and heap allocations per run,
+ * so two result files can simply be diffed.
+ */
+typedef std::chrono::steady_clock BenchClock;
+
+typedef struct BenchMark {
+  BenchClock::time_point started;
+  unsigned long allocations;
+} BenchMark;
+
+/*
+ * malloc, calloc and realloc calls made by the process so far
+ */
+unsigned long benchAllocations();
+
+inline BenchMark benchStart() {
+  return BenchMark { BenchClock::now(), benchAllocations() };
+}
+
+inline double benchElapsed(const BenchMark &since) {
+  return std::chrono::duration<double, std::milli>(BenchClock::now() - since.started).count();
+}
+
+void benchHeader();
+void benchReport(const char *name, size_t size, const BenchMark &since);
+void benchReport(const char *name, size_t size, std::vector<double> *samples,
+    unsigned long allocations);
+
+/*
+ * Runs body the given number of times, every run is one sample
+ */
+template <typename Body>
+void benchRun(const char *name, size_t size, int runs, Body body) {
+  std::vector<double> samples;
+  unsigned long allocations = 0;
+
+  for (int i = 0; i < runs; i++) {
+    BenchMark mark = benchStart();
+    body();
+    samples.push_back(benchElapsed(mark));
+    allocations += benchAllocations() - mark.allocations;
+  }
+
+  benchReport(name, size, &samples, allocations / runs);
+}
+
+void runFetchBench();
+void runMergeBench();
+void runRenderBench(int lines, int columns, int size);
+void runSortBench();
+void runTableBench();
+void runUiBench();
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include "chk-ctl.h"
+#include "fake-systemd.h"
+
+/*
+ * Fetch, merge, group and toggle against the fake systemd, latency is
+ * per method call
+ */
+static void benchFetch(int size, int latency, int runs) {
+  FakeSystemd fake(size, latency);
+  fake.start();
+
+  ChkBus *bus = new ChkBus();
+  UnitArena arena;
+
+  benchRun("fetch/all-units", size, runs, [&]() {
+    arena.reset();
+    bus->getAllUnits(&arena);
+  });
+
+  ChkCTL *ctl = new ChkCTL();
+
+  BenchMark started = benchStart();
+  ctl->fetchStart();
+  ctl->fetchNext();
+  benchReport("fetch/first-step", size, started);
+
+  while (ctl->isFetching()) {
+    ctl->fetchNext();
+  }
+  benchReport("fetch/cold", size, started);
+
+  benchRun("fetch/refresh", size, runs, [&]() {
+    ctl->fetch();
+  });
+
+  benchRun("fetch/group", size, runs, [&]() {
+    ctl->getItemsSorted();
+  });
+
+  delete ctl;
+
+  benchRun("fetch/toggle", size, runs, [&]() {
+    bus->stopUnit(FAKE_SSH_UNIT);
+    bus->startUnit(FAKE_SSH_UNIT);
+  });
+
+  delete bus;
+  fake.stop();
+}
+
+void runFetchBench() {
+  benchFetch(100, 0, 20);
+  benchFetch(1000, 0, 20);
+  benchFetch(10000, 0, 10);
+  benchFetch(100000, 0, 5);
+  benchFetch(10000, 200, 5);
+}
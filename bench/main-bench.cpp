@@ -0,0 +1,48 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.h"
+
+/*
+ * chkservice-bench runs every benchmark,
+ * chkservice-bench render [lines [columns [units]]] only the render one
+ */
+int main(int ac, char **av) {
+  benchHeader();
+
+  if (ac > 1 && strcmp(av[1], "render") == 0) {
+    runRenderBench(ac > 2 ? atoi(av[2]) : 24, ac > 3 ? atoi(av[3]) : 80,
+        ac > 4 ? atoi(av[4]) : 10000);
+    return 0;
+  }
+
+  runFetchBench();
+  runMergeBench();
+  runSortBench();
+  runTableBench();
+  runUiBench();
+  runRenderBench(24, 80, 10000);
+  runRenderBench(50, 160, 10000);
+
+  return 0;
+}
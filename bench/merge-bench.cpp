@@ -0,0 +1,130 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "chk-systemd.h"
+
+/*
+ * Unit files and loaded units as ListUnitFiles/ListUnits would return them:
+ * every other unit file is loaded, plus template instances and units
+ * without a file.
+ */
+static void makeUnits(size_t size, std::vector<UnitInfo *> *files,
+    std::vector<UnitInfo *> *units) {
+  char id[64];
+
+  for (size_t i = 0; i < size; i++) {
+    UnitInfo *file = new UnitInfo();
+
+    snprintf(id, sizeof(id), "unit-%zu.service", i);
+    file->id = strdup(id);
+    file->unitPath = strdup(id);
+    file->state = strdup("enabled");
+    files->push_back(file);
+
+    if (i % 2 != 0) {
+      continue;
+    }
+
+    UnitInfo *unit = new UnitInfo();
+
+    if (i % 10 == 0) {
+      snprintf(id, sizeof(id), "dev-disk-%zu.device", i);
+    } else {
+      snprintf(id, sizeof(id), "unit-%zu.service", i);
+    }
+
+    unit->id = strdup(id);
+    unit->unitPath = strdup(id);
+    units->push_back(unit);
+  }
+}
+
+static void freeUnits(std::vector<UnitInfo *> *units) {
+  for (auto unit : (*units)) {
+    ChkBus::freeUnitInfo(unit);
+    delete unit;
+  }
+  units->clear();
+}
+
+/*
+ * The nested scan getAllUnits used before the index
+ */
+static void nestedMerge(std::vector<UnitInfo *> *files,
+    std::vector<UnitInfo *> *units, std::vector<UnitInfo *> *orphans) {
+  for (auto unit : (*units)) {
+    bool found = false;
+
+    for (auto file : (*files)) {
+      std::string uid(unit->id);
+      std::string fid(file->id);
+
+      if (uid.find(fid) == 0) {
+        free((void *)file->id);
+        file->id = unit->id;
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      orphans->push_back(unit);
+    } else {
+      free((void *)unit->unitPath);
+      delete unit;
+    }
+  }
+}
+
+static void benchMerge(size_t size, bool nested) {
+  std::vector<UnitInfo *> files;
+  std::vector<UnitInfo *> units;
+  std::vector<UnitInfo *> orphans;
+
+  makeUnits(size, &files, &units);
+
+  BenchMark started = benchStart();
+
+  if (nested) {
+    nestedMerge(&files, &units, &orphans);
+  } else {
+    ChkBus::mergeUnits(&files, &units, &orphans);
+  }
+
+  benchReport(nested ? "merge/nested" : "merge/index", size, started);
+
+  freeUnits(&files);
+  freeUnits(&orphans);
+}
+
+/*
+ * The nested scan is quadratic, at 100k units it runs for minutes,
+ * so it is only measured on the smaller set.
+ */
+void runMergeBench() {
+  benchMerge(10000, true);
+  benchMerge(10000, false);
+  benchMerge(100000, false);
+}
@@ -0,0 +1,230 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "chk-ui.h"
+#include "fake-systemd.h"
+
+#define RENDER_PIPE_SIZE (1024 * 1024)
+
+/*
+ * Upper bounds of the frame time histogram, in milliseconds
+ */
+static const double buckets[] = { 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100 };
+static const int bucketsCount = sizeof(buckets) / sizeof(buckets[0]);
+
+typedef struct RenderScript {
+  const char *name;
+  const char *setup;
+  const char *keys;
+  int repeat;
+} RenderScript;
+
+/*
+ * Every script starts at the top of the list, setup keys are not measured
+ */
+static const RenderScript scripts[] = {
+  { "hold-j", "", "j", 500 },
+  { "page-down", "", "f", 100 },
+  { "search", "", "/fake-1\n", 25 },
+  { "search-next", "/fake-1\n", "/\n", 100 },
+  { "filter", "", "Ffake-12\033", 25 },
+};
+
+/*
+ * A terminal that writes to a pipe, whatever ncurses emitted for a frame
+ * is drained and counted right after it
+ */
+typedef struct RenderTerminal {
+  SCREEN *screen;
+  FILE *out;
+  FILE *in;
+  int readFd;
+} RenderTerminal;
+
+static bool openTerminal(RenderTerminal *terminal, int lines, int columns) {
+  const char *term = getenv("TERM");
+  int fds[2];
+
+  if (pipe2(fds, O_CLOEXEC) < 0) {
+    return false;
+  }
+
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(fds[1], F_SETPIPE_SZ, RENDER_PIPE_SIZE);
+
+  terminal->readFd = fds[0];
+  terminal->out = fdopen(fds[1], "w");
+  terminal->in = fopen("/dev/null", "r");
+  terminal->screen = newterm(term != NULL ? term : "xterm", terminal->out, terminal->in);
+
+  if (terminal->screen == NULL) {
+    fclose(terminal->out);
+    fclose(terminal->in);
+    close(terminal->readFd);
+    return false;
+  }
+
+  set_term(terminal->screen);
+  resize_term(lines, columns);
+  setupCurses();
+
+  return true;
+}
+
+static size_t drainTerminal(RenderTerminal *terminal) {
+  char buffer[BUFSIZ];
+  size_t total = 0;
+  ssize_t size;
+
+  fflush(terminal->out);
+
+  while ((size = read(terminal->readFd, buffer, sizeof(buffer))) > 0) {
+    total += size;
+  }
+
+  return total;
+}
+
+static void closeTerminal(RenderTerminal *terminal) {
+  endwin();
+  delscreen(terminal->screen);
+  fclose(terminal->out);
+  fclose(terminal->in);
+  close(terminal->readFd);
+}
+
+static void sendKeys(MainWindow *window, const char *keys) {
+  for (const char *key = keys; *key != 0; key++) {
+    window->handleKey(*key);
+  }
+}
+
+static void reportHistogram(const std::string &name, size_t size,
+    const std::vector<double> &samples) {
+  int counts[bucketsCount + 1];
+
+  memset(counts, 0, sizeof(counts));
+
+  for (double sample : samples) {
+    int bucket = 0;
+
+    while (bucket < bucketsCount && sample > buckets[bucket]) {
+      bucket++;
+    }
+
+    counts[bucket]++;
+  }
+
+  for (int i = 0; i <= bucketsCount; i++) {
+    if (i < bucketsCount) {
+      fprintf(stdout, "%s/hist\t%zu\t<=%g\t%d\n", name.c_str(), size, buckets[i], counts[i]);
+    } else {
+      fprintf(stdout, "%s/hist\t%zu\t>%g\t%d\n", name.c_str(), size, buckets[i - 1], counts[i]);
+    }
+  }
+}
+
+static void runScript(MainWindow *window, RenderTerminal *terminal,
+    const RenderScript *script, size_t size) {
+  std::string name = std::string("render/") + script->name;
+  std::vector<double> samples;
+  std::vector<double> bytes;
+  size_t total = 0;
+  unsigned long allocations = 0;
+
+  sendKeys(window, "gF\033");
+  sendKeys(window, script->setup);
+  window->drawUnits();
+  drainTerminal(terminal);
+
+  /*
+   * One frame per key, the way the event loop draws a single keystroke
+   */
+  for (int i = 0; i < script->repeat; i++) {
+    for (const char *key = script->keys; *key != 0; key++) {
+      BenchMark mark = benchStart();
+      window->handleKey(*key);
+      window->drawUnits();
+      samples.push_back(benchElapsed(mark));
+      allocations += benchAllocations() - mark.allocations;
+
+      size_t written = drainTerminal(terminal);
+      bytes.push_back(written);
+      total += written;
+    }
+  }
+
+  size_t frames = samples.size();
+
+  benchReport(name.c_str(), size, &samples, allocations / frames);
+  reportHistogram(name, size, samples);
+  benchReport((name + "/bytes").c_str(), size, &bytes, 0);
+  fprintf(stdout, "%s/bytes-total\t%zu\t%zu\t%zu\n", name.c_str(), size, frames, total);
+  fflush(stdout);
+}
+
+/*
+ * Scripted keys against MainWindow on a virtual terminal of the given
+ * size. Frame times are reported as percentiles and a histogram. The
+ * /bytes lines have what the terminal received per frame in place of
+ * milliseconds, that is what a slow ssh link pays for.
+ */
+void runRenderBench(int lines, int columns, int size) {
+  RenderTerminal terminal;
+
+  if (!openTerminal(&terminal, lines, columns)) {
+    fprintf(stderr, "render: can not open a terminal\n");
+    return;
+  }
+
+  FakeSystemd fake(size);
+  fake.start();
+
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  window->drawUnits();
+
+  size_t first = drainTerminal(&terminal);
+  fprintf(stdout, "render/first-frame/bytes-total\t%d\t1\t%zu\n", size, first);
+
+  while (window->isLoading()) {
+    window->applyUpdates();
+    window->drawUnits();
+  }
+
+  size_t loading = drainTerminal(&terminal);
+  fprintf(stdout, "render/loading/bytes-total\t%d\t1\t%zu\n", size, loading);
+
+  for (auto &script : scripts) {
+    runScript(window, &terminal, &script, size);
+  }
+
+  delete window;
+  fake.stop();
+  closeTerminal(&terminal);
+}
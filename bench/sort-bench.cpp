@@ -0,0 +1,109 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "chk-ctl.h"
+
+/*
+ * Ids with mixed case and shared prefixes, in random order
+ */
+static void makeItems(size_t size, std::vector<UnitItem *> *items,
+    UnitArena *arena) {
+  static const char *prefixes[] = { "systemd-", "dev-disk-by\\x2duuid-", "User-", "sys-devices-" };
+  static const char *targets[] = { "service", "device", "mount", "Socket" };
+  std::mt19937 random(size);
+  char id[64];
+
+  for (size_t i = 0; i < size; i++) {
+    UnitItem *item = new UnitItem();
+
+    snprintf(id, sizeof(id), "%s%08x.%s", prefixes[random() % 4],
+        (unsigned int)random(), targets[random() % 4]);
+    item->id = arena->copy(id);
+    items->push_back(item);
+  }
+}
+
+static void freeItems(std::vector<UnitItem *> *items) {
+  for (auto item : (*items)) {
+    delete item;
+  }
+  items->clear();
+}
+
+/*
+ * The comparator sortByName used before the collation keys
+ */
+static void toupperSort(std::vector<UnitItem *> *sortable) {
+  std::stable_sort(sortable->begin(), sortable->end(), [](const UnitItem *a, const UnitItem *b) {
+    const char* s1 = a->id.c_str();
+    const char* s2 = b->id.c_str();
+    while(true) {
+       if ( std::toupper(*s1) < std::toupper(*s2) ) return true;
+       if ( std::toupper(*s1) > std::toupper(*s2) ) return false;
+       if ( *s1 == 0 && *s2 == 0 ) return false;
+       if ( *s1 > *s2) return false;
+       if ( *s1 < *s2) return true;
+       ++s1; ++s2;
+    }
+  });
+}
+
+static void benchSort(size_t size) {
+  std::vector<UnitItem *> items;
+  std::vector<UnitItem *> sorted;
+  UnitArena arena;
+
+  makeItems(size, &items, &arena);
+
+  sorted = items;
+  BenchMark started = benchStart();
+  toupperSort(&sorted);
+  benchReport("sort/toupper", size, started);
+
+  std::vector<UnitItem *> expected = sorted;
+
+  started = benchStart();
+  for (auto item : items) {
+    ChkCTL::setSortKey(item);
+  }
+  benchReport("sort/keys", size, started);
+
+  benchRun("sort/keyed", size, 10, [&]() {
+    sorted = items;
+    ChkCTL::sortByName(&sorted);
+  });
+
+  if (sorted != expected) {
+    fprintf(stderr, "sort/keyed: order differs from sort/toupper\n");
+  }
+
+  freeItems(&items);
+}
+
+void runSortBench() {
+  benchSort(10000);
+  benchSort(100000);
+}
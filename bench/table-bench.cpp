@@ -0,0 +1,55 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "bench.h"
+#include "chk-ctl.h"
+
+static const char *targets[] = { "service", "device", "mount", "socket", "timer", "slice" };
+
+/*
+ * Whole list operations over the unit table, each of them should stay
+ * well under a millisecond for the list sizes of a busy host
+ */
+static void benchTable(int size) {
+  UnitTable table;
+  std::vector<int> rows;
+
+  for (int i = 0; i < size; i++) {
+    UnitItem *item = new UnitItem();
+
+    item->target = targets[i % 6];
+    table.add(item);
+  }
+
+  benchRun("table/select-type", size, 50, [&]() {
+    table.selectByType("service", &rows);
+  });
+
+  for (auto item : table.getItems()) {
+    delete item;
+  }
+}
+
+void runTableBench() {
+  benchTable(50000);
+  benchTable(200000);
+}
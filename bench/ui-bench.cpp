@@ -0,0 +1,118 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+
+#include "bench.h"
+#include "chk-ui.h"
+#include "fake-systemd.h"
+
+#define UI_BENCH_LINES 50
+#define UI_BENCH_COLUMNS 160
+
+static void sendKeys(MainWindow *window, const char *keys) {
+  for (const char *key = keys; *key != 0; key++) {
+    window->handleKey(*key);
+  }
+}
+
+static void loadAll(MainWindow *window) {
+  while (window->isLoading()) {
+    window->applyUpdates();
+    window->drawUnits();
+  }
+}
+
+/*
+ * MainWindow against the fake systemd, drawn through ncurses to
+ * /dev/null. Every run is a key and the frame it causes.
+ */
+static void benchWindow(int size, int runs) {
+  const char *term = getenv("TERM");
+  FILE *out = fopen("/dev/null", "w");
+  FILE *in = fopen("/dev/null", "r");
+  SCREEN *screen = newterm(term != NULL ? term : "xterm", out, in);
+
+  if (screen == NULL) {
+    fprintf(stderr, "ui: can not open a terminal on /dev/null\n");
+    fclose(out);
+    fclose(in);
+    return;
+  }
+
+  set_term(screen);
+  resize_term(UI_BENCH_LINES, UI_BENCH_COLUMNS);
+  setupCurses();
+
+  FakeSystemd fake(size);
+  fake.start();
+
+  /*
+   * Time to first frame, then to the whole list the way the event
+   * loop gets there, a fetch step and a frame at a time
+   */
+  BenchMark started = benchStart();
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  window->drawUnits();
+  benchReport("ui/first-frame", size, started);
+
+  loadAll(window);
+  benchReport("ui/loaded", size, started);
+
+  benchRun("ui/move-down", size, runs, [&]() {
+    window->handleKey('j');
+    window->drawUnits();
+  });
+
+  benchRun("ui/page-down", size, runs, [&]() {
+    window->handleKey('f');
+    window->drawUnits();
+  });
+
+  sendKeys(window, "g/fake-1\n");
+  window->drawUnits();
+
+  benchRun("ui/search-next", size, runs, [&]() {
+    sendKeys(window, "/\n");
+    window->drawUnits();
+  });
+
+  benchRun("ui/reload", size, runs < 10 ? runs : 10, [&]() {
+    window->handleKey('r');
+    window->drawUnits();
+    loadAll(window);
+  });
+
+  delete window;
+  fake.stop();
+
+  endwin();
+  delscreen(screen);
+  fclose(out);
+  fclose(in);
+}
+
+void runUiBench() {
+  benchWindow(100, 200);
+  benchWindow(1000, 200);
+  benchWindow(10000, 100);
+  benchWindow(100000, 50);
+}
@@ -0,0 +1,92 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHK_ARENA_H
+#define _CHK_ARENA_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Size of the first arena block, larger snapshots add blocks
+ */
+#define ARENA_BLOCK_SIZE (256 * 1024)
+
+/*
+ * Bump allocator backing one snapshot of units. Nothing is freed one by
+ * one, reset() drops the whole snapshot at once and keeps the memory for
+ * the next one. After a reset all the blocks used are merged into one.
+ */
+class UnitArena {
+  public:
+    UnitArena();
+    ~UnitArena();
+
+    void *alloc(size_t size);
+    const char *copy(const char *value);
+    const char *copy(const char *value, size_t length);
+    const char *intern(const char *value);
+    void reset();
+    size_t capacity();
+
+  private:
+    typedef struct Block {
+      char *data;
+      size_t size;
+    } Block;
+
+    std::vector<Block> blocks;
+    std::vector<const char *> interned;
+    size_t current = 0;
+    size_t offset = 0;
+
+    void addBlock(size_t size);
+};
+
+/*
+ * Read only view of a nul terminated string, usually kept in a UnitArena.
+ * The string must outlive the view.
+ */
+class UnitString {
+  public:
+    UnitString() : value(""), count(0) {}
+    UnitString(const char *value) : value(value == NULL ? "" : value),
+      count(value == NULL ? 0 : strlen(value)) {}
+
+    const char *c_str() const { return value; }
+    const char *data() const { return value; }
+    size_t size() const { return count; }
+    size_t length() const { return count; }
+    bool empty() const { return count == 0; }
+    char operator[](size_t i) const { return value[i]; }
+    operator std::string() const { return std::string(value, count); }
+
+    bool startsWith(const char *prefix) const;
+    int compare(const std::string &other) const;
+    bool operator==(const UnitString &other) const;
+    bool operator!=(const UnitString &other) const { return !(*this == other); }
+
+  private:
+    const char *value;
+    size_t count;
+};
+
+#endif
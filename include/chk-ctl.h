@@ -21,14 +21,44 @@
 #ifndef _CHK_CTL_H
 #define _CHK_CTL_H
 
+#include <cstdint>
+#include <unordered_map>
+
+#include "chk-details.h"
 #include "chk-systemd.h"
+#include "chk-table.h"
+#include "chk-worker.h"
 
+/*
+ * line caches the formatted text of the item for lineWidth columns,
+ * lineSplit is where its description part starts. Setting lineWidth
+ * to 0 makes the line to be formatted again.
+ * sortKey is the collation key of id, sortPrefix its first 8 bytes.
+ * id, target and description point into the arena of the last fetch.
+ * row is the row of the item in the unit table, -1 for separators.
+ * detailed is set once description came from systemd, items of unit
+ * files that are not loaded show their path until loadDetails.
+ * hasFile is set for units with a unit file, the others are dropped
+ * when systemd unloads them. Strings that come after the fetch, ids of
+ * units added since and loaded descriptions, are kept in idText and
+ * descriptionText instead of the arena.
+ */
 typedef struct UnitItem {
-  std::string id;
-  std::string target;
-  std::string description;
+  UnitString id;
+  UnitString target;
+  UnitString description;
   int sub;
   int state;
+  std::string line;
+  int lineWidth;
+  int lineSplit;
+  std::string sortKey;
+  uint64_t sortPrefix;
+  int row = -1;
+  bool detailed = false;
+  bool hasFile = false;
+  std::string idText;
+  std::string descriptionText;
 } UnitItem;
 
 enum {
@@ -47,21 +77,90 @@ enum {
   UNIT_SUBSTATE_TMP = 0x4a
 };
 
+/*
+ * Steps of a progressive fetch
+ */
+enum {
+  FETCH_IDLE,
+  FETCH_FILES,
+  FETCH_PUSH,
+  FETCH_UNITS,
+  FETCH_ORPHANS
+};
+
+/*
+ * Unit files shown with the first step of a progressive fetch,
+ * every next step shows twice as many
+ */
+#define FETCH_FIRST_BATCH 1024
+
+enum {
+  UNIT_UPDATE_NONE = 0x00,
+  UNIT_UPDATE_ROWS = 0x01,
+  UNIT_UPDATE_LIST = 0x02
+};
+
 class ChkCTL {
   public:
     ChkCTL();
+    ChkCTL(ChkBus *bus);
     ~ChkCTL();
     ChkBus *bus;
-    std::vector<UnitItem *> getItemsSorted();
+    ChkWorker *worker;
+    const std::vector<UnitItem *> &getItemsSorted();
     std::vector<UnitItem *> getByTarget(const char *target);
     std::vector<UnitItem *> getItems();
     void toggleUnitState(UnitItem *item);
+    void toggleUnitStates(const std::vector<UnitItem *> &items);
     void toggleUnitSubState(UnitItem *item);
     void fetch();
+    void fetchStart();
+    int fetchNext();
+    bool isFetching();
+    int update();
+    int loadDetails(const std::vector<UnitItem *> &items, int from, int count);
+    UnitItem *findItem(const char *id);
+    static void setSortKey(UnitItem *item);
+    static void sortByName(std::vector<UnitItem *> *sortable);
   private:
-    std::vector<UnitItem *> items;
-    void pushItem(UnitInfo *unit);
-    void sortByName(std::vector<UnitItem *> *sortable);
+    UnitArena arena;
+    UnitTable table;
+    std::unordered_map<std::string, UnitItem *> index;
+    std::set<std::string> pending;
+    DetailsCache details;
+    std::set<UnitItem *> detailsPending;
+    std::vector<UnitItem *> sorted;
+    std::vector<std::vector<UnitItem *>> buckets;
+    std::vector<int> bucketOrder;
+    std::vector<UnitItem *> titles;
+    std::vector<int> selected;
+    UnitItem *separator = NULL;
+    int fetching = FETCH_IDLE;
+    std::vector<UnitInfo *> fetchFiles;
+    std::vector<UnitItem *> fetchItems;
+    std::vector<UnitInfo *> fetchOrphans;
+    size_t fetchPushed = 0;
+    size_t fetchBatch = 0;
+    size_t fetchRemoved = 0;
+    int fetchFileStep();
+    int fetchPushStep();
+    int fetchUnitsStep();
+    int fetchOrphansStep();
+    void fetchDone();
+    UnitItem *getTitle(int type);
+    void setState(UnitItem *item, int state);
+    void setSub(UnitItem *item, int sub);
+    void setDescription(UnitItem *item, const std::string &description);
+    void clearItems();
+    UnitItem *pushItem(UnitInfo *unit);
+    UnitItem *addItem(const char *id);
+    void removeItem(UnitItem *item);
+    void reserveJobs(size_t count);
+    void postJob(int op, UnitItem *item);
+    void postJobs(int op, const std::vector<std::string> &ids);
+    static int parseState(const char *value);
+    static int parseSub(const char *value);
+    static bool isUnitFile(const char *state);
 };
 
 #endif
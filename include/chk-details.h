@@ -0,0 +1,58 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHK_DETAILS_H
+#define _CHK_DETAILS_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Units whose properties are kept, the least recently used ones
+ * are dropped first
+ */
+#define DETAILS_CACHE_SIZE 4096
+
+/*
+ * Unit properties loaded on demand, keyed by unit id. Entries outlive
+ * fetches, so a reload shows what was loaded before without asking
+ * systemd again.
+ */
+class DetailsCache {
+  public:
+    DetailsCache(size_t capacity = DETAILS_CACHE_SIZE);
+    ~DetailsCache();
+
+    const std::string *find(const std::string &id);
+    void put(const std::string &id, const std::string &description);
+    bool erase(const std::string &id);
+    void clear();
+    size_t size();
+
+  private:
+    typedef std::pair<std::string, std::string> Entry;
+
+    size_t capacity;
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHK_SEARCH_H
+#define _CHK_SEARCH_H
+
+#include <unordered_map>
+
+#include "chk-ctl.h"
+
+/*
+ * Case insensitive substring search over ids and descriptions of a
+ * list of items. A trigram index narrows candidates of a new query,
+ * a query that extends the previous one only rechecks its matches.
+ * Matches are line numbers of the list, in ascending order.
+ */
+class ChkSearch {
+  public:
+    ChkSearch();
+    ~ChkSearch();
+
+    void build(const std::vector<UnitItem *> &rows);
+    const std::vector<int> &find(const char *query);
+    void clear();
+
+    bool isMatch(int row);
+    int next(int row);
+    int prev(int row);
+    size_t count();
+
+  private:
+    std::vector<std::string> texts;
+    std::unordered_map<uint32_t, std::vector<int>> trigrams;
+    std::vector<std::string> queries;
+    std::vector<std::vector<int>> results;
+    std::vector<char> matches;
+    std::vector<int> empty;
+
+    void setMatches(bool value);
+    void candidates(const std::string &query, std::vector<int> *found);
+    static uint32_t trigram(const char *text);
+};
+
+#endif
@@ -26,9 +26,25 @@
 #include <vector>
 #include <systemd/sd-bus.h>
 
+#include "chk-arena.h"
+
 #define ERR_PREFIX "Failed: "
 #define SYSV_INSTALL_EXEC "/lib/systemd/systemd-sysv-install"
 
+/*
+ * Amount of async calls kept in flight on one connection.
+ * The system bus limits pending replies per connection, so large batches
+ * are sent in windows of this size.
+ */
+#define BUS_PIPELINE_DEPTH 64
+
+/*
+ * Reconnect attempts after the bus went away,
+ * the delay (ms) doubles after each failed one
+ */
+#define BUS_RECONNECT_ATTEMPTS 5
+#define BUS_RECONNECT_DELAY 50
+
 enum STATE_FLAGS {
   STATE_FLAGS_ENABLE,
   STATE_FLAGS_DISABLE,
@@ -45,21 +61,146 @@ typedef struct UnitInfo {
   const char *state;
 } UnitInfo;
 
+enum UNIT_EVENTS {
+  UNIT_EVENT_NEW,
+  UNIT_EVENT_REMOVED,
+  UNIT_EVENT_JOB,
+  UNIT_EVENT_FILES,
+  UNIT_EVENT_STATE,
+  UNIT_EVENT_SUB,
+  UNIT_EVENT_DETAILS,
+  UNIT_EVENT_CHANGED,
+  UNIT_EVENT_RECONNECT,
+  UNIT_EVENT_NO_REPLY
+};
+
+/*
+ * Something changed for a unit, collected from systemd signals
+ * and replies to async requests
+ */
+typedef struct UnitEvent {
+  int type;
+  std::string id;
+  std::string value;
+} UnitEvent;
+
+/*
+ * Units to list, empty lists mean every unit. Types and patterns narrow
+ * unit names, states are either unit file states (enabled, static, ...)
+ * or runtime states (running, failed, ...).
+ */
+typedef struct UnitScope {
+  std::vector<std::string> types;
+  std::vector<std::string> states;
+  std::vector<std::string> patterns;
+} UnitScope;
+
+enum UNIT_LIST_STATES {
+  UNIT_LIST_IDLE,
+  UNIT_LIST_PENDING,
+  UNIT_LIST_DONE
+};
+
+/*
+ * A ListUnitFiles or ListUnits call in flight. The reply is parsed into
+ * units as soon as it is dispatched, whatever call is waited for then.
+ * Releasing slot cancels the call.
+ */
+typedef struct UnitListRequest {
+  bool files;
+  int state;
+  sd_bus_slot *slot;
+  UnitArena *arena;
+  std::vector<UnitInfo *> units;
+  int status;
+  std::string error;
+} UnitListRequest;
+
+typedef struct ChkBusStats {
+  unsigned long connects;
+  unsigned long reuses;
+  unsigned long reconnects;
+} ChkBusStats;
+
+typedef struct UnitStateRequest {
+  UnitInfo *unit;
+  int *pending;
+  UnitArena *arena;
+} UnitStateRequest;
+
+/*
+ * Open addressing index over unit file ids.
+ * Lookups walk the prefixes of a unit id with a rolling hash, so a unit
+ * is joined with its unit file without any allocation per comparison.
+ */
+class UnitIndex {
+  public:
+    UnitIndex(std::vector<UnitInfo *> *files);
+    ~UnitIndex();
+
+    int findPrefix(const char *id, size_t *slot);
+    void rename(size_t slot, const char *id);
+
+  private:
+    typedef struct Slot {
+      uint64_t hash;
+      size_t length;
+      int idx;
+    } Slot;
+
+    std::vector<UnitInfo *> *files;
+    std::vector<Slot> slots;
+    std::vector<bool> lengths;
+    size_t mask;
+    size_t used = 0;
+
+    void insert(int idx);
+    void rehash();
+    static uint64_t hashStep(uint64_t hash, char c);
+};
+
 class ChkBus {
   public:
     ChkBus();
-    ~ChkBus();
+    virtual ~ChkBus();
 
     bool connect();
     void disconnect();
     bool isConnected();
+    ChkBusStats getStats();
 
     void setErrorMessage(int status);
     void setErrorMessage(const char *message);
 
-    std::vector<UnitInfo *> getUnits();
-    std::vector<UnitInfo *> getUnitFiles();
-    std::vector<UnitInfo *> getAllUnits();
+    /*
+     * Scoped listing is filtered by systemd with the *ByPatterns
+     * methods, instead of every unit on the system
+     */
+    void setScope(const UnitScope &scope);
+    bool isScoped();
+    bool inScope(const char *id);
+
+    /*
+     * Units are kept in arena when one is given, otherwise every
+     * unit is allocated on its own and freed with freeUnitInfo
+     */
+    std::vector<UnitInfo *> getUnits(UnitArena *arena = NULL);
+    virtual std::vector<UnitInfo *> getUnitFiles(UnitArena *arena = NULL);
+    virtual std::vector<UnitInfo *> getAllUnits(UnitArena *arena = NULL);
+
+    /*
+     * Parts of getAllUnits: loaded units without their unit file
+     * states, and the states of the given units
+     */
+    virtual std::vector<UnitInfo *> listUnits(UnitArena *arena = NULL);
+
+    /*
+     * listUnits in two halves, other calls can be made while the reply
+     * is on its way. takeUnits calls listUnits when nothing was requested.
+     */
+    virtual void requestUnits(UnitArena *arena = NULL);
+    virtual std::vector<UnitInfo *> takeUnits(UnitArena *arena = NULL);
+    void getStates(std::vector<UnitInfo *> *units, UnitArena *arena = NULL);
 
     void disableUnit(const char *name);
     void enableUnit(const char *name);
@@ -72,19 +213,65 @@ class ChkBus {
     void stopUnits(std::set<std::string> *ids);
 
     static void freeUnitInfo(UnitInfo *unit);
+    static void mergeUnits(std::vector<UnitInfo *> *files,
+        std::vector<UnitInfo *> *units, std::vector<UnitInfo *> *orphans,
+        UnitArena *arena = NULL);
 
     void reloadDaemon();
 
+    virtual void subscribe();
+    int getFd();
+    int getEvents();
+    uint64_t getTimeout();
+    bool processEvents();
+    std::vector<UnitEvent> takeEvents();
+    void requestState(const char *id);
+    void requestSub(const char *id);
+    void requestDetails(const char *id);
+
   private:
     sd_bus* bus = NULL;
     std::string errorMessage;
-    const char* getState(const char *name);
+    ChkBusStats stats = { 0, 0, 0 };
+    bool subscribed = false;
+    bool dropped = false;
+    std::vector<UnitEvent> events;
+    bool scoped = false;
+    std::vector<std::string> scopePatterns;
+    std::vector<std::string> scopeFileStates;
+    std::vector<std::string> scopeUnitStates;
+    UnitListRequest fileList = { true };
+    UnitListRequest unitList = { false };
+    void ensureConnected();
+    bool isOpen();
+    void drop();
+    void callList(UnitListRequest *request, UnitArena *arena);
+    std::vector<UnitInfo *> waitList(UnitListRequest *request);
+    static void dropList(UnitListRequest *request);
+    static int onListReply(sd_bus_message *reply, void *userdata, sd_bus_error *error);
+    void filterScope(std::vector<UnitInfo *> *files, std::vector<UnitInfo *> *orphans,
+        UnitArena *arena);
+    void addMatches();
+    void pushEvent(int type, const char *id, const char *value);
+    static int onRequestReply(sd_bus_message *reply, void *userdata, sd_bus_error *error);
+    static int floatRequest(sd_bus_slot *slot);
+    static void freeRequest(void *userdata);
+    static int onUnitNew(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onUnitRemoved(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onJobRemoved(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onUnitFilesChanged(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onPropertiesChanged(sd_bus_message *message, void *userdata, sd_bus_error *error);
     void applyUnitState(const char *method, char **names, int flags);
     void applyUnitSub(const char *name, const char *method);
     void checkDisabledStatus(char **names);
 };
 
 int busParseUnit(sd_bus_message *message, UnitInfo *u);
+UnitInfo *busNewUnit(UnitArena *arena);
+const char *busCopy(UnitArena *arena, const char *value);
+const char *busIntern(UnitArena *arena, const char *value);
+int busAppendStrings(sd_bus_message *message, const std::vector<std::string> &values);
+int busOnUnitState(sd_bus_message *reply, void *userdata, sd_bus_error *error);
 void applySYSv(const char *state, const char **names);
 
 #endif
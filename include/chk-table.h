@@ -0,0 +1,64 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHK_TABLE_H
+#define _CHK_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct UnitItem;
+
+/*
+ * Units by rows, with the type of every row kept in an array of its
+ * own, so grouping and selecting by type run through a few contiguous
+ * bytes per unit instead of following a pointer per unit.
+ * Type ids stay the same across clear(), the first types registered
+ * get the lowest ids.
+ */
+class UnitTable {
+  public:
+    void clear();
+    int add(UnitItem *item);
+    void remove(int row);
+    void setState(int row, int state);
+    void setSub(int row, int sub);
+
+    int typeId(const char *type);
+    const std::string &typeName(int type);
+    int typesCount();
+
+    int size();
+    UnitItem *item(int row);
+    int type(int row);
+    const std::vector<UnitItem *> &getItems();
+
+    void selectByType(const char *prefix, std::vector<int> *rows);
+
+  private:
+    std::vector<UnitItem *> items;
+    std::vector<uint16_t> types;
+    std::deque<std::string> typeNames;
+    std::vector<uint8_t> typeMask;
+};
+
+#endif
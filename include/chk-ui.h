@@ -22,11 +22,14 @@
 #define _CHK_UI_H
 
 #include <curses.h>
+#include <unordered_set>
 #include "chk-ctl.h"
+#include "chk-search.h"
 
 enum _INPUT_FOR {
   INPUT_FOR_LIST,
-  INPUT_FOR_SEARCH
+  INPUT_FOR_SEARCH,
+  INPUT_FOR_FILTER
 };
 
 /*
@@ -36,6 +39,18 @@ enum _INPUT_FOR {
 #define CTRL(c) ((c) & 037)
 #endif
 
+/*
+ * Descriptors watched by the main loop
+ */
+enum _LOOP_FD {
+  LOOP_FD_INPUT,
+  LOOP_FD_BUS,
+  LOOP_FD_TIMER,
+  LOOP_FD_SIGNAL,
+  LOOP_FD_WORKER,
+  LOOP_FDS
+};
+
 typedef struct RECTANGLE {
   int x;
   int y;
@@ -43,40 +58,91 @@ typedef struct RECTANGLE {
   int h;
 } RECTANGLE;
 
+/*
+ * What was drawn on a list line, used to skip unchanged lines
+ */
+typedef struct FrameRow {
+  UnitItem *unit;
+  int state;
+  int sub;
+  bool selected;
+  bool match;
+  bool marked;
+} FrameRow;
+
 class MainWindow {
   public:
-    WINDOW *win;
+    WINDOW *win = NULL;
     MainWindow();
     ~MainWindow();
     void createMenu();
+    void setScope(const UnitScope &scope);
+    /*
+     * Window without the event loop, keys are fed by the caller
+     */
+    void createWindow();
+    void handleKey(int key);
+    void drawUnits();
+    int applyUpdates();
+    bool isLoading();
+    /*
+     * Unit under the cursor, NULL on an empty list or a separator, and
+     * its number among the units shown, 0 without one
+     */
+    UnitItem *getCursorUnit();
+    int getCursorPosition();
+    int totalUnits();
   private:
     RECTANGLE *screenSize = new RECTANGLE();
     RECTANGLE *winSize = new RECTANGLE();
     RECTANGLE *padding = new RECTANGLE();
     ChkCTL *ctl = new ChkCTL;
+    ChkSearch *search = new ChkSearch();
+    std::vector<UnitItem *> allUnits;
     std::vector<UnitItem *> units;
+    std::vector<FrameRow> frame;
+    int frameStart = 0;
     int selected = 0;
     int start = 0;
-    int totalUnits();
+    std::vector<int> ordinals;
+    std::vector<int> unitRows;
+    std::vector<int> nextRows;
+    std::vector<int> prevRows;
+    int unitsCount = 0;
+    bool fetched = false;
+    void indexUnits();
     unsigned char inputFor = 0;
-    void createWindow();
+    int timerFd = -1;
+    int signalFd = -1;
+    void createLoop();
+    void armBusTimer();
+    void resizeTerminal();
     void resize();
     void setSize();
     void moveUp();
     void moveDown();
     void movePageUp();
     void movePageDown();
+    void movePage(int direction);
     void movePageEnd();
+    void movePageStart();
     void moveTo(int position);
-    void drawUnits();
-    void drawItem(UnitItem *unit, int y);
+    void placeCursor(int row);
+    int pageSize();
+    int unitRow(int row, int direction);
+    void scrollFrame(int lines);
+    void invalidateFrame();
+    void formatItem(UnitItem *unit);
+    void drawItem(UnitItem *unit, int y, bool match, bool marked);
     void drawStatus(int position, const char *text, int color);
     void drawInfo();
     void toggleUnitState();
+    void toggleMarkedUnits();
     void toggleUnitSubState();
     void updateUnits();
+    void setAllUnits(const std::vector<UnitItem *> &list);
+    void showUnits(const std::vector<UnitItem *> &list);
     void error(char *err);
-    void reloadAll();
     void listInput(int key);
     /*
      * Status bar
@@ -86,9 +152,39 @@ class MainWindow {
     void drawSearch();
     void searchInput(int key);
     void searchNext();
+    bool searchDirty = true;
+    void buildSearch();
+    void searchUpdate();
+    void searchMove(int direction);
+    /*
+     * Marked units, by id so that marks outlive a reload. Space toggles
+     * all of them at once. markFrom is where a range mark started.
+     */
+    std::unordered_set<std::string> marks;
+    std::string markFrom;
+    bool isMarked(UnitItem *unit);
+    void markUnit();
+    void markRange();
+    void markMatches();
+    void markAll();
+    void clearMarks();
+    /*
+     * Filter view
+     */
+    char filterString[BUFSIZ] = "";
+    ChkSearch *filter = new ChkSearch();
+    bool filterDirty = true;
+    std::vector<std::string> filterQueries;
+    std::vector<std::vector<UnitItem *>> filterViews;
+    std::unordered_map<std::string, UnitItem *> groupTitles;
+    UnitItem *groupSeparator = NULL;
+    void applyFilter();
+    void filterInput(int key);
+    void drawFilter();
 };
 
 void startCurses();
+void setupCurses();
 void stopCurses();
 void printInMiddle(WINDOW *win, int starty, int startx, int width,
     char *string, chtype color, char *sp);
@@ -0,0 +1,152 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHK_WORKER_H
+#define _CHK_WORKER_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "chk-systemd.h"
+
+#define WORKER_QUEUE_SIZE 256
+
+enum WORKER_OPS {
+  WORKER_OP_START,
+  WORKER_OP_STOP,
+  WORKER_OP_ENABLE,
+  WORKER_OP_DISABLE
+};
+
+enum WORKER_STATUS {
+  WORKER_STATUS_DONE,
+  WORKER_STATUS_FAILED
+};
+
+/*
+ * A job runs one operation on every unit of ids, enable and disable
+ * send them all in one call
+ */
+typedef struct WorkerJob {
+  int op;
+  std::vector<std::string> ids;
+} WorkerJob;
+
+/*
+ * One result per unit of a job. state is the unit file state read
+ * after an enable or disable, empty when it could not be read.
+ */
+typedef struct WorkerResult {
+  int op;
+  int status;
+  std::string id;
+  std::string error;
+  std::string state;
+} WorkerResult;
+
+/*
+ * Lock-free ring buffer for exactly one producer and one consumer thread.
+ * One slot is kept empty to tell a full queue from an empty one.
+ */
+template <typename T, size_t N>
+class SpscQueue {
+  public:
+    bool push(const T &value) {
+      size_t tail = this->tail.load(std::memory_order_relaxed);
+      size_t next = (tail + 1) % N;
+
+      if (next == head.load(std::memory_order_acquire)) {
+        return false;
+      }
+
+      buffer[tail] = value;
+      this->tail.store(next, std::memory_order_release);
+
+      return true;
+    }
+
+    bool pop(T *value) {
+      size_t head = this->head.load(std::memory_order_relaxed);
+
+      if (head == tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+
+      *value = buffer[head];
+      this->head.store((head + 1) % N, std::memory_order_release);
+
+      return true;
+    }
+
+    /*
+     * Free slots as the producer sees them, the consumer can only
+     * free more meanwhile
+     */
+    size_t space() {
+      size_t tail = this->tail.load(std::memory_order_relaxed);
+      size_t head = this->head.load(std::memory_order_acquire);
+
+      return (head + N - tail - 1) % N;
+    }
+
+  private:
+    T buffer[N];
+    std::atomic<size_t> head { 0 };
+    std::atomic<size_t> tail { 0 };
+};
+
+/*
+ * Runs start/stop/enable/disable calls on its own thread and bus
+ * connection, so a slow systemd reply never blocks the interface.
+ * Jobs are posted by the UI thread, results are read back by it once
+ * the descriptor from getFd() becomes readable. Deleting the worker
+ * waits for the bus call in flight, not for the jobs queued.
+ */
+class ChkWorker {
+  public:
+    ChkWorker();
+    ~ChkWorker();
+
+    bool post(int op, const char *id);
+    bool post(int op, const std::vector<std::string> &ids);
+    size_t space();
+    bool takeResult(WorkerResult *result);
+    int getFd();
+
+  private:
+    ChkBus *bus;
+    std::thread thread;
+    std::atomic<bool> running { false };
+    SpscQueue<WorkerJob, WORKER_QUEUE_SIZE> jobs;
+    SpscQueue<WorkerResult, WORKER_QUEUE_SIZE> results;
+    int jobsFd;
+    int resultsFd;
+
+    void run();
+    void execute(WorkerJob *job);
+    void postResults(WorkerJob *job, int status, const char *error);
+    void postResult(int op, const std::string &id, int status, const char *error,
+        const char *state);
+};
+
+bool notify(int fd);
+
+#endif
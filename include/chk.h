@@ -30,19 +30,32 @@
 \n\
     [x] - enabled unit.  [ ] - disabled unit \n\
     [s] - static unit.   -m- - masked unit \n\
+    [~] - pending change. ~ - pending start/stop \n\
 \n\
   Navigation keys:\n\
 \n\
     Up/k   - move cursor up. Down/j   - move cursor down.\n\
     PgUp/b - move page up.   PgDown/f - move page down.\n\
-    / - for search.\n\
+    / - search. Up/Down - previous/next match.\n\
+    F - filter, Esc - show all units.\n\
 \n\
   Action keys:\n\
 \n\
     r     - reload/update.   q - exit.\n\
     Space - enable/disable.  s - start/stop unit.\n\
+    m/v/a/* - mark unit/range/all/matches. u - unmark.\n\
 \n\
   License:\n\
     GPLv3 (c) Svetlana Linuxenko"
 
+#define USAGE_INFO "\n\
+\n\
+  Options:\n\
+\n\
+    --type=service,timer  - only units of these types.\n\
+    --state=running       - only units in these states, unit file\n\
+                            (enabled, static, ..) or runtime ones.\n\
+    --pattern='app-*'     - only units with matching names.\n\
+\n"
+
 #endif
@@ -0,0 +1,155 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+#include "chk-arena.h"
+
+UnitArena::UnitArena() {
+  addBlock(ARENA_BLOCK_SIZE);
+}
+
+UnitArena::~UnitArena() {
+  for (auto block : blocks) {
+    free(block.data);
+  }
+}
+
+void UnitArena::addBlock(size_t size) {
+  Block block;
+
+  block.data = (char *)malloc(size);
+  block.size = size;
+
+  if (block.data == NULL) {
+    throw std::string("Failed: out of memory");
+  }
+
+  blocks.push_back(block);
+}
+
+/*
+ * Blocks are filled in order, a request which does not fit
+ * in what is left moves to the next block
+ */
+void *UnitArena::alloc(size_t size) {
+  const size_t align = alignof(std::max_align_t);
+
+  offset = (offset + align - 1) & ~(align - 1);
+
+  while (offset + size > blocks[current].size) {
+    current++;
+    offset = 0;
+
+    if (current == blocks.size()) {
+      addBlock(std::max(size, blocks[current - 1].size * 2));
+    }
+  }
+
+  void *ptr = blocks[current].data + offset;
+  offset += size;
+
+  return ptr;
+}
+
+const char *UnitArena::copy(const char *value, size_t length) {
+  char *str = (char *)alloc(length + 1);
+
+  memcpy(str, value, length);
+  str[length] = '\0';
+
+  return str;
+}
+
+const char *UnitArena::copy(const char *value) {
+  return value == NULL ? NULL : copy(value, strlen(value));
+}
+
+/*
+ * One copy per distinct value, meant for the small sets of unit
+ * types and states repeated by every unit
+ */
+const char *UnitArena::intern(const char *value) {
+  if (value == NULL) {
+    return NULL;
+  }
+
+  for (auto str : interned) {
+    if (strcmp(str, value) == 0) {
+      return str;
+    }
+  }
+
+  interned.push_back(copy(value));
+
+  return interned.back();
+}
+
+void UnitArena::reset() {
+  interned.clear();
+  current = 0;
+  offset = 0;
+
+  if (blocks.size() == 1) {
+    return;
+  }
+
+  size_t size = 0;
+
+  for (auto block : blocks) {
+    size += block.size;
+    free(block.data);
+  }
+
+  blocks.clear();
+  addBlock(size);
+}
+
+size_t UnitArena::capacity() {
+  size_t size = 0;
+
+  for (auto block : blocks) {
+    size += block.size;
+  }
+
+  return size;
+}
+
+bool UnitString::startsWith(const char *prefix) const {
+  size_t prefixLength = strlen(prefix);
+
+  return prefixLength <= count && memcmp(value, prefix, prefixLength) == 0;
+}
+
+int UnitString::compare(const std::string &other) const {
+  int result = memcmp(value, other.data(), std::min(count, other.size()));
+
+  if (result != 0) {
+    return result;
+  }
+
+  return count < other.size() ? -1 : (count > other.size() ? 1 : 0);
+}
+
+bool UnitString::operator==(const UnitString &other) const {
+  return count == other.count && memcmp(value, other.value, count) == 0;
+}
@@ -19,198 +19,815 @@
  */
 
 #include <algorithm>
+#include <cstring>
 
 #include "chk-ctl.h"
 #include "chk-systemd.h"
 
-ChkCTL::ChkCTL() {
-  bus = new ChkBus();
-  items.clear();
+/*
+ * Unit types shown first, in this order
+ */
+static const char *orderedTargets[] = { "service", "timer", "socket" };
+static const size_t orderedTargetsCount = sizeof(orderedTargets) / sizeof(orderedTargets[0]);
+
+ChkCTL::ChkCTL() : ChkCTL(new ChkBus()) {
+}
+
+/*
+ * ChkCTL owns bus, and every item, title and separator it hands out.
+ * Items live until the next fetch, or until systemd unloads the unit
+ * when it has no unit file.
+ */
+ChkCTL::ChkCTL(ChkBus *bus) {
+  this->bus = bus;
+  worker = new ChkWorker();
+
+  // ordered types take the lowest type ids
+  for (auto target : orderedTargets) {
+    table.typeId(target);
+  }
 }
 
 ChkCTL::~ChkCTL() {
+  delete worker;
   delete bus;
-  items.clear();
+  delete separator;
+
+  for (auto title : titles) {
+    delete title;
+  }
+
+  clearItems();
+}
+
+void ChkCTL::clearItems() {
+  for (auto item : table.getItems()) {
+    delete item;
+  }
+
+  table.clear();
+  index.clear();
+  pending.clear();
+  detailsPending.clear();
 }
 
 std::vector<UnitItem *> ChkCTL::getItems() {
+  std::vector<UnitItem *> items = table.getItems();
+
   sortByName(&items);
   return items;
 }
 
 std::vector<UnitItem *> ChkCTL::getByTarget(const char *target) {
   std::vector<UnitItem *> found;
-  std::string pattern = target == NULL ? "" : target;
 
-  for (UnitItem *item : items) {
-    if (item->target.find(pattern) == 0) {
-      found.push_back(item);
-    }
+  table.selectByType(target, &selected);
+  found.reserve(selected.size());
+
+  for (int row : selected) {
+    found.push_back(table.item(row));
   }
 
   return found;
 }
 
 void ChkCTL::fetch() {
-  std::vector<UnitInfo *> sysUnits;
+  fetchStart();
 
-  for (auto item : items) {
-    delete item;
+  while (isFetching()) {
+    fetchNext();
+  }
+}
+
+/*
+ * Progressive fetch. Unit files are shown first, a growing batch at
+ * a time, then loaded units are merged into them and last come units
+ * without a unit file. Each fetchNext() does one step and returns what
+ * changed, the list is complete when isFetching() turns false. Scoped
+ * lists are small and are fetched in a single step.
+ */
+void ChkCTL::fetchStart() {
+  clearItems();
+  fetchDone();
+
+  /*
+   * Strings of the previous snapshot go all at once,
+   * nothing points into them anymore
+   */
+  arena.reset();
+
+  try {
+    bus->subscribe();
+  } catch (std::string &err) {
+    throw err;
   }
 
-  items.clear();
-  items.shrink_to_fit();
+  fetching = FETCH_FILES;
+}
+
+bool ChkCTL::isFetching() {
+  return fetching != FETCH_IDLE;
+}
+
+int ChkCTL::fetchNext() {
+  int changed = UNIT_UPDATE_NONE;
 
   try {
-    sysUnits = bus->getAllUnits();
+    switch (fetching) {
+      case FETCH_FILES:
+        changed = fetchFileStep();
+        break;
+      case FETCH_PUSH:
+        changed = fetchPushStep();
+        break;
+      case FETCH_UNITS:
+        changed = fetchUnitsStep();
+        break;
+      case FETCH_ORPHANS:
+        changed = fetchOrphansStep();
+        break;
+      default:
+        break;
+    }
   } catch (std::string &err) {
+    fetchDone();
     throw err;
   }
 
-  for (auto unit : sysUnits) {
-    if (unit->id) {
+  return changed;
+}
+
+int ChkCTL::fetchFileStep() {
+  if (bus->isScoped()) {
+    for (auto unit : bus->getAllUnits(&arena)) {
+      if (unit->id) {
+        pushItem(unit);
+      }
+    }
+
+    fetchDone();
+    return UNIT_UPDATE_LIST;
+  }
+
+  /*
+   * ListUnits goes out first, its reply comes while the unit files are
+   * listed and is taken by the FETCH_UNITS step
+   */
+  bus->requestUnits(&arena);
+  fetchFiles = bus->getUnitFiles(&arena);
+  fetchItems.assign(fetchFiles.size(), NULL);
+  fetchBatch = FETCH_FIRST_BATCH;
+  fetching = FETCH_PUSH;
+
+  return fetchPushStep();
+}
+
+int ChkCTL::fetchPushStep() {
+  size_t end = std::min(fetchFiles.size(), fetchPushed + fetchBatch);
+
+  /*
+   * A unit announced by a signal meanwhile already has its item. There
+   * are such items only while the table has more than was pushed, not
+   * counting the items removed since.
+   */
+  for (; fetchPushed < end; fetchPushed++) {
+    UnitInfo *file = fetchFiles[fetchPushed];
+    UnitItem *item = table.size() + fetchRemoved > fetchPushed ?
+        findItem(file->id) : NULL;
+
+    if (item != NULL) {
+      item->hasFile = true;
+    }
+
+    fetchItems[fetchPushed] = item != NULL ? item : pushItem(file);
+  }
+
+  fetchBatch *= 2;
+
+  if (fetchPushed == fetchFiles.size()) {
+    fetching = FETCH_UNITS;
+  }
+
+  return UNIT_UPDATE_LIST;
+}
+
+/*
+ * Loaded units take over the items of their unit files, the same way
+ * ChkBus::mergeUnits joins them
+ */
+int ChkCTL::fetchUnitsStep() {
+  std::vector<UnitInfo *> units = bus->takeUnits(&arena);
+  int changed = UNIT_UPDATE_ROWS;
+
+  ChkBus::mergeUnits(&fetchFiles, &units, &fetchOrphans, &arena);
+
+  for (size_t i = 0; i < fetchFiles.size(); i++) {
+    UnitInfo *file = fetchFiles[i];
+    UnitItem *item = fetchItems[i];
+
+    if (file->loadState == NULL || item == NULL) {
+      continue;
+    }
+
+    /*
+     * Details asked under the old id are answered for that id
+     */
+    if (strcmp(item->id.c_str(), file->id) != 0) {
+      detailsPending.erase(item);
+      index.erase(std::string(item->id));
+      item->id = file->id;
+      setSortKey(item);
+      index[item->id] = item;
+      changed = UNIT_UPDATE_LIST;
+    }
+
+    if (file->description != NULL) {
+      item->description = file->description;
+      item->detailed = true;
+    }
+
+    item->lineWidth = 0;
+    setSub(item, parseSub(file->subState));
+  }
+
+  fetching = FETCH_ORPHANS;
+
+  return changed;
+}
+
+int ChkCTL::fetchOrphansStep() {
+  bus->getStates(&fetchOrphans, &arena);
+
+  for (auto unit : fetchOrphans) {
+    if (unit->id && findItem(unit->id) == NULL) {
       pushItem(unit);
     }
-    delete unit;
   }
 
-  sysUnits.clear();
-  sysUnits.shrink_to_fit();
+  fetchDone();
+
+  return UNIT_UPDATE_LIST;
+}
+
+void ChkCTL::fetchDone() {
+  fetching = FETCH_IDLE;
+  fetchPushed = 0;
+  fetchBatch = 0;
+  fetchRemoved = 0;
+  fetchFiles.clear();
+  fetchFiles.shrink_to_fit();
+  fetchItems.clear();
+  fetchItems.shrink_to_fit();
+  fetchOrphans.clear();
+}
+
+/*
+ * Ids are ordered case-insensitively, with the uppercase letter first
+ * where two ids differ only in case. Each character becomes the pair
+ * (folded, original) so that a plain byte comparison of the keys gives
+ * that order.
+ */
+void ChkCTL::setSortKey(UnitItem *item) {
+  const UnitString &id = item->id;
+
+  item->sortKey.resize(id.length() * 2);
+
+  for (size_t i = 0; i < id.length(); i++) {
+    char c = id[i];
+
+    item->sortKey[i * 2] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    item->sortKey[i * 2 + 1] = c;
+  }
+
+  item->sortPrefix = 0;
+
+  for (size_t i = 0; i < sizeof(item->sortPrefix); i++) {
+    unsigned char c = i < item->sortKey.length() ? item->sortKey[i] : 0;
+    item->sortPrefix = (item->sortPrefix << 8) | c;
+  }
 }
 
 void ChkCTL::sortByName(std::vector<UnitItem *> *sortable) {
-  std::sort(sortable->begin(), sortable->end(), [](const UnitItem *a, const UnitItem *b) {
-    const char* s1 = a->id.c_str();
-    const char* s2 = b->id.c_str();
-    while(true) {
-       if ( std::toupper(*s1) < std::toupper(*s2) ) return true;
-       if ( std::toupper(*s1) > std::toupper(*s2) ) return false;
-       if ( *s1 == 0 && *s2 == 0 ) return false;
-       if ( *s1 > *s2) return false;
-       if ( *s1 < *s2) return true;
-       ++s1; ++s2;
+  std::stable_sort(sortable->begin(), sortable->end(), [](const UnitItem *a, const UnitItem *b) {
+    if (a->sortPrefix != b->sortPrefix) {
+      return a->sortPrefix < b->sortPrefix;
     }
+
+    return a->sortKey.compare(b->sortKey) < 0;
   });
 }
 
-void ChkCTL::pushItem(UnitInfo *unit) {
-  UnitItem *item = new UnitItem();
+int ChkCTL::parseState(const char *value) {
+  std::string state(value);
+
+  if (state.find("enabled") == 0) {
+    return UNIT_STATE_ENABLED;
+  } else if (state.find("mask") == 0) {
+    return UNIT_STATE_MASKED;
+  } else if (state.find("static") == 0) {
+    return UNIT_STATE_STATIC;
+  } else if (state.find("bad") == 0 || state.find("removed") == 0) {
+    return UNIT_STATE_BAD;
+  }
+
+  return UNIT_STATE_DISABLED;
+}
+
+/*
+ * GetUnitFileState answers for transient units too, they have no file
+ */
+bool ChkCTL::isUnitFile(const char *state) {
+  return state != NULL && state[0] != 0 && strcmp(state, "transient") != 0;
+}
+
+int ChkCTL::parseSub(const char *value) {
+  std::string sub(value == NULL ? "" : value);
 
-  std::string id(unit->id);
+  if (sub.empty()) {
+    return UNIT_SUBSTATE_INVALID;
+  } else if (sub.find("running") == 0) {
+    return UNIT_SUBSTATE_RUNNING;
+  }
+
+  return UNIT_SUBSTATE_CONNECTED;
+}
+
+UnitItem *ChkCTL::pushItem(UnitInfo *unit) {
+  UnitItem *item = new UnitItem();
+  const char *type = strrchr(unit->id, '.');
 
-  item->id = id;
-  item->target = id.substr(id.find_last_of('.') + 1, id.length());
-  item->description = std::string((unit->description == NULL ?
-      unit->unitPath : unit->description));
+  item->id = unit->id;
+  item->target = arena.intern(type == NULL ? unit->id : type + 1);
+  setSortKey(item);
+  item->description = unit->description == NULL ?
+      unit->unitPath : unit->description;
+  item->detailed = unit->description != NULL;
+  item->hasFile = isUnitFile(unit->state);
 
   if (unit->state != NULL) {
-    std::string state(unit->state);
-    std::string sub(unit->subState == NULL ? "" : unit->subState);
-
-    if (state.find("enabled") == 0) {
-      item->state = UNIT_STATE_ENABLED;
-    } else if (state.find("mask") == 0) {
-      item->state = UNIT_STATE_MASKED;
-    } else if (state.find("static") == 0) {
-      item->state = UNIT_STATE_STATIC;
-    } else if (state.find("bad") == 0 || state.find("removed") == 0) {
-      item->state = UNIT_STATE_BAD;
-    } else {
-      item->state = UNIT_STATE_DISABLED;
-    }
+    item->state = parseState(unit->state);
+    item->sub = parseSub(unit->subState);
+  } else {
+    item->state = UNIT_STATE_MASKED;
+  }
+
+  table.add(item);
+  index[item->id] = item;
+
+  return item;
+}
 
-    if (!sub.empty()) {
-      if (sub.find("running") == 0) {
-        item->sub = UNIT_SUBSTATE_RUNNING;
+/*
+ * A unit systemd loaded after the last fetch
+ */
+UnitItem *ChkCTL::addItem(const char *id) {
+  UnitItem *item = new UnitItem();
+  const char *type = strrchr(id, '.');
+
+  item->idText = id;
+  item->id = item->idText.c_str();
+  item->target = arena.intern(type == NULL ? id : type + 1);
+  setSortKey(item);
+  item->state = UNIT_STATE_TMP;
+  item->sub = UNIT_SUBSTATE_TMP;
+
+  table.add(item);
+  index[item->id] = item;
+
+  return item;
+}
+
+/*
+ * Whoever holds the items has to take them again, update() returns
+ * UNIT_UPDATE_LIST for that
+ */
+void ChkCTL::removeItem(UnitItem *item) {
+  std::string id(item->id);
+
+  table.remove(item->row);
+  index.erase(id);
+  pending.erase(id);
+  detailsPending.erase(item);
+
+  /*
+   * A fetch under way holds the items of the unit files it pushed,
+   * a transient file is one of them
+   */
+  if (fetching != FETCH_IDLE) {
+    std::replace(fetchItems.begin(), fetchItems.end(), item, (UnitItem *)NULL);
+    fetchRemoved++;
+  }
+
+  delete item;
+}
+
+UnitItem *ChkCTL::findItem(const char *id) {
+  auto found = index.find(id);
+
+  return found == index.end() ? NULL : found->second;
+}
+
+/*
+ * Patches items in place from the signals received since the last call.
+ * Returns UNIT_UPDATE_ROWS when some items changed and UNIT_UPDATE_LIST
+ * when items were added and the list has to be regrouped.
+ */
+int ChkCTL::update() {
+  int changed = UNIT_UPDATE_NONE;
+  bool refetch = false;
+  std::string failed;
+  WorkerResult result;
+
+  try {
+    /*
+     * Finished jobs ask for the real state, it replaces the pending
+     * marker whether the job succeeded or not. Enable and disable come
+     * with the state already read by the worker.
+     */
+    while (worker->takeResult(&result)) {
+      UnitItem *item = findItem(result.id.c_str());
+
+      if (item != NULL && !result.state.empty()) {
+        setState(item, parseState(result.state.c_str()));
+        pending.erase(item->id);
+        changed |= UNIT_UPDATE_ROWS;
+      } else if (result.op == WORKER_OP_ENABLE || result.op == WORKER_OP_DISABLE) {
+        bus->requestState(result.id.c_str());
       } else {
-        item->sub = UNIT_SUBSTATE_CONNECTED;
+        bus->requestSub(result.id.c_str());
+      }
+
+      if (result.status == WORKER_STATUS_FAILED) {
+        failed = result.error;
       }
-    } else {
-        item->sub = UNIT_SUBSTATE_INVALID;
     }
 
-  } else {
-    item->state = UNIT_STATE_MASKED;
+    bus->processEvents();
+
+    for (auto event : bus->takeEvents()) {
+      UnitItem *item = findItem(event.id.c_str());
+
+      switch (event.type) {
+        case UNIT_EVENT_NEW:
+          if (item == NULL && bus->inScope(event.id.c_str())) {
+            addItem(event.id.c_str());
+            bus->requestState(event.id.c_str());
+            bus->requestSub(event.id.c_str());
+            changed |= UNIT_UPDATE_LIST;
+          }
+          break;
+        case UNIT_EVENT_REMOVED:
+          /*
+           * Units without a unit file do not come back with the next
+           * fetch, there is no reason to keep them until then
+           */
+          if (item != NULL && !item->hasFile) {
+            removeItem(item);
+            changed |= UNIT_UPDATE_LIST;
+          } else if (item != NULL && item->sub != UNIT_SUBSTATE_INVALID) {
+            setSub(item, UNIT_SUBSTATE_INVALID);
+            changed |= UNIT_UPDATE_ROWS;
+          }
+          break;
+        case UNIT_EVENT_JOB:
+          if (item != NULL) {
+            bus->requestSub(event.id.c_str());
+          }
+          break;
+        case UNIT_EVENT_FILES:
+          for (auto id : pending) {
+            bus->requestState(id.c_str());
+          }
+          break;
+        case UNIT_EVENT_STATE:
+          if (item != NULL) {
+            setState(item, parseState(event.value.c_str()));
+            item->hasFile |= isUnitFile(event.value.c_str());
+            pending.erase(item->id);
+            changed |= UNIT_UPDATE_ROWS;
+          }
+          break;
+        case UNIT_EVENT_SUB:
+          if (item != NULL) {
+            setSub(item, parseSub(event.value.c_str()));
+            changed |= UNIT_UPDATE_ROWS;
+          }
+          break;
+        case UNIT_EVENT_DETAILS:
+          details.put(event.id, event.value);
+
+          if (item != NULL) {
+            detailsPending.erase(item);
+            setDescription(item, event.value);
+            changed |= UNIT_UPDATE_ROWS;
+          }
+          break;
+        case UNIT_EVENT_CHANGED:
+          /*
+           * Details of the item are loaded again next time it is shown
+           */
+          if (details.erase(event.id) && item != NULL) {
+            item->detailed = false;
+          }
+          break;
+        case UNIT_EVENT_RECONNECT:
+          refetch = true;
+          break;
+        case UNIT_EVENT_NO_REPLY:
+          /*
+           * Details not answered are asked again next time the item
+           * is shown, the pipeline slot is free meanwhile
+           */
+          detailsPending.erase(item);
+          break;
+        default:
+          break;
+      }
+    }
+
+    /*
+     * Signals sent while the bus was away are lost, and so are the
+     * answers to what was asked before, the list is fetched again
+     */
+    if (refetch) {
+      fetchStart();
+      changed |= UNIT_UPDATE_LIST;
+    }
+  } catch (std::string &err) {
+    throw err;
   }
 
-  bus->freeUnitInfo(unit);
+  if (!failed.empty()) {
+    throw failed;
+  }
 
-  items.push_back(item);
-};
+  return changed;
+}
 
-std::vector<UnitItem *> ChkCTL::getItemsSorted() {
-  std::vector<std::string> orderedTargets;
-  std::vector<UnitItem *> sunits;
-  bool alreadyHasTarget = false;
+/*
+ * Details of count items from from on, the rows on screen and the ones
+ * about to be. Cached details are set right away, the rest is asked from
+ * systemd in one batch and comes back through update(). Rows already
+ * asked for are skipped, and so is the rest while the pipeline is full,
+ * so drawing the same rows again does not allocate. Returns
+ * UNIT_UPDATE_ROWS when some items changed.
+ */
+int ChkCTL::loadDetails(const std::vector<UnitItem *> &items, int from, int count) {
+  int changed = UNIT_UPDATE_NONE;
+  int end = std::min((int)items.size(), from + count);
 
-  orderedTargets.push_back("service");
-  orderedTargets.push_back("timer");
-  orderedTargets.push_back("socket");
+  for (int i = std::max(from, 0); i < end; i++) {
+    UnitItem *item = items[i];
 
-  for (const auto unit : items) {
-    alreadyHasTarget = false;
-    for (auto t : orderedTargets) {
-      if (t.find(unit->target) == 0) {
-        alreadyHasTarget = true;
-        break;
-      }
+    if (item->detailed || item->id.empty() || detailsPending.count(item) != 0) {
+      continue;
     }
-    if (!alreadyHasTarget) {
-      orderedTargets.push_back(unit->target);
+
+    if (detailsPending.size() >= BUS_PIPELINE_DEPTH) {
+      break;
+    }
+
+    std::string id(item->id);
+    const std::string *description = details.find(id);
+
+    if (description != NULL) {
+      setDescription(item, *description);
+      changed = UNIT_UPDATE_ROWS;
+    } else {
+      detailsPending.insert(item);
+      bus->requestDetails(id.c_str());
     }
   }
 
-  bool isFirst = false;
+  return changed;
+}
 
-  for (std::string target : orderedTargets) {
-    auto targetedUnits = getByTarget(target.c_str());
-    sortByName(&targetedUnits);
+/*
+ * An empty description is kept as a result too, the item then keeps
+ * its path instead of asking again
+ */
+void ChkCTL::setDescription(UnitItem *item, const std::string &description) {
+  if (!description.empty()) {
+    item->descriptionText = description;
+    item->description = item->descriptionText.c_str();
+  }
+
+  item->detailed = true;
+  item->lineWidth = 0;
+}
+
+/*
+ * Titles outlive fetches, type ids and names do not change
+ */
+UnitItem *ChkCTL::getTitle(int type) {
+  while ((int)titles.size() <= type) {
+    titles.push_back(NULL);
+  }
+
+  if (titles[type] == NULL) {
+    titles[type] = new UnitItem();
+    titles[type]->target = table.typeName(type).c_str();
+  }
 
-    if (isFirst) {
-      UnitItem *separatorTitle = new UnitItem();
-      UnitItem *separator = new UnitItem();
-      separatorTitle->target = target;
+  return titles[type];
+}
 
-      sunits.push_back(separator);
-      sunits.push_back(separatorTitle);
-      sunits.push_back(separator);
+/*
+ * Items grouped by unit type in a single pass over the type column,
+ * each group sorted by name. Groups, separators and the result are kept
+ * between calls, so regrouping does not allocate.
+ */
+const std::vector<UnitItem *> &ChkCTL::getItemsSorted() {
+  int size = table.size();
+
+  bucketOrder.clear();
+  buckets.resize(table.typesCount());
+
+  for (auto &bucket : buckets) {
+    bucket.clear();
+  }
+
+  for (int type = 0; type < (int)orderedTargetsCount; type++) {
+    bucketOrder.push_back(type);
+  }
+
+  for (int row = 0; row < size; row++) {
+    int type = table.type(row);
+
+    if (buckets[type].empty() && type >= (int)orderedTargetsCount) {
+      bucketOrder.push_back(type);
     }
 
-    sunits.insert(sunits.end(), targetedUnits.begin(), targetedUnits.end());
-    isFirst = true;
+    buckets[type].push_back(table.item(row));
+  }
+
+  if (separator == NULL) {
+    separator = new UnitItem();
   }
 
-  return sunits;
+  sorted.clear();
+  sorted.reserve(size + buckets.size() * 3);
+
+  for (int type : bucketOrder) {
+    std::vector<UnitItem *> &targetedUnits = buckets[type];
+
+    if (targetedUnits.empty()) {
+      continue;
+    }
+
+    sortByName(&targetedUnits);
+
+    if (!sorted.empty()) {
+      sorted.push_back(separator);
+      sorted.push_back(getTitle(type));
+      sorted.push_back(separator);
+    }
+
+    sorted.insert(sorted.end(), targetedUnits.begin(), targetedUnits.end());
+  }
+
+  return sorted;
+}
+
+/*
+ * State changes go through the table to keep its columns current
+ */
+void ChkCTL::setState(UnitItem *item, int state) {
+  if (item->row < 0) {
+    item->state = state;
+  } else {
+    table.setState(item->row, state);
+  }
+}
+
+void ChkCTL::setSub(UnitItem *item, int sub) {
+  if (item->row < 0) {
+    item->sub = sub;
+  } else {
+    table.setSub(item->row, sub);
+  }
+}
+
+/*
+ * Start/stop/enable/disable run on the worker thread, the item shows
+ * a pending marker until the result comes back through update()
+ */
+/*
+ * A toggle is up to three jobs, either they all fit in the queue or
+ * none is posted
+ */
+void ChkCTL::reserveJobs(size_t count) {
+  if (worker->space() < count) {
+    throw std::string(ERR_PREFIX "too many pending operations");
+  }
+}
+
+void ChkCTL::postJob(int op, UnitItem *item) {
+  if (!worker->post(op, item->id.c_str())) {
+    throw std::string(ERR_PREFIX "too many pending operations");
+  }
+}
+
+void ChkCTL::postJobs(int op, const std::vector<std::string> &ids) {
+  if (!ids.empty() && !worker->post(op, ids)) {
+    throw std::string(ERR_PREFIX "too many pending operations");
+  }
 }
 
 void ChkCTL::toggleUnitState(UnitItem *item) {
   try {
+    if (item->state == UNIT_STATE_TMP || item->sub == UNIT_SUBSTATE_TMP) {
+      throw std::string(ERR_PREFIX "operation in progress");
+    }
+
     if (item->state == UNIT_STATE_ENABLED || item->state == UNIT_STATE_STATIC) {
+      bool stop = item->sub == UNIT_SUBSTATE_RUNNING || item->sub == UNIT_SUBSTATE_CONNECTED;
 
-      if (item->sub == UNIT_SUBSTATE_RUNNING || item->sub == UNIT_SUBSTATE_CONNECTED) {
-        bus->stopUnit(item->id.c_str());
+      reserveJobs(stop ? 2 : 1);
+
+      if (stop) {
+        postJob(WORKER_OP_STOP, item);
+        setSub(item, UNIT_SUBSTATE_TMP);
       }
-      bus->disableUnit(item->id.c_str());
+      postJob(WORKER_OP_DISABLE, item);
+
+    } else if (item->state == UNIT_STATE_DISABLED) {
+      postJob(WORKER_OP_ENABLE, item);
+    } else {
+      return;
+    }
+
+    setState(item, UNIT_STATE_TMP);
+    pending.insert(item->id);
+  } catch (std::string &err) {
+    throw err;
+  }
+}
+
+/*
+ * toggleUnitState for many items at once. Every operation goes to the
+ * worker as one job for all its units, enable and disable then cost one
+ * call each however many units there are. Items with an operation in
+ * progress are left out.
+ */
+void ChkCTL::toggleUnitStates(const std::vector<UnitItem *> &items) {
+  std::vector<std::string> stop;
+  std::vector<std::string> disable;
+  std::vector<std::string> enable;
+  std::vector<UnitItem *> toggled;
+
+  for (auto item : items) {
+    if (item->id.empty() || item->state == UNIT_STATE_TMP || item->sub == UNIT_SUBSTATE_TMP) {
+      continue;
+    }
 
+    if (item->state == UNIT_STATE_ENABLED || item->state == UNIT_STATE_STATIC) {
+      if (item->sub == UNIT_SUBSTATE_RUNNING || item->sub == UNIT_SUBSTATE_CONNECTED) {
+        stop.push_back(item->id);
+      }
+      disable.push_back(item->id);
     } else if (item->state == UNIT_STATE_DISABLED) {
-      bus->enableUnit(item->id.c_str());
+      enable.push_back(item->id);
+    } else {
+      continue;
     }
 
-    item->state = UNIT_STATE_TMP;
+    toggled.push_back(item);
+  }
+
+  try {
+    reserveJobs(!stop.empty() + !disable.empty() + !enable.empty());
+    postJobs(WORKER_OP_STOP, stop);
+    postJobs(WORKER_OP_DISABLE, disable);
+    postJobs(WORKER_OP_ENABLE, enable);
   } catch (std::string &err) {
     throw err;
   }
+
+  for (auto item : toggled) {
+    if (item->state != UNIT_STATE_DISABLED &&
+        (item->sub == UNIT_SUBSTATE_RUNNING || item->sub == UNIT_SUBSTATE_CONNECTED)) {
+      setSub(item, UNIT_SUBSTATE_TMP);
+    }
+
+    setState(item, UNIT_STATE_TMP);
+    pending.insert(item->id);
+  }
 }
 
 void ChkCTL::toggleUnitSubState(UnitItem *item) {
   try {
+    if (item->state == UNIT_STATE_TMP || item->sub == UNIT_SUBSTATE_TMP) {
+      throw std::string(ERR_PREFIX "operation in progress");
+    }
+
     if (item->sub != UNIT_SUBSTATE_RUNNING) {
-      bus->startUnit(item->id.c_str());
+      postJob(WORKER_OP_START, item);
     } else {
-      bus->stopUnit(item->id.c_str());
+      postJob(WORKER_OP_STOP, item);
     }
 
-    item->sub = UNIT_SUBSTATE_TMP;
+    setSub(item, UNIT_SUBSTATE_TMP);
   } catch (std::string &err) {
     throw err;
   }
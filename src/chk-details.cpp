@@ -0,0 +1,83 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chk-details.h"
+
+DetailsCache::DetailsCache(size_t capacity) {
+  this->capacity = capacity == 0 ? 1 : capacity;
+}
+
+DetailsCache::~DetailsCache() {
+}
+
+/*
+ * A found entry becomes the most recently used one
+ */
+const std::string *DetailsCache::find(const std::string &id) {
+  auto found = index.find(id);
+
+  if (found == index.end()) {
+    return NULL;
+  }
+
+  entries.splice(entries.begin(), entries, found->second);
+
+  return &found->second->second;
+}
+
+void DetailsCache::put(const std::string &id, const std::string &description) {
+  auto found = index.find(id);
+
+  if (found != index.end()) {
+    found->second->second = description;
+    entries.splice(entries.begin(), entries, found->second);
+    return;
+  }
+
+  if (entries.size() >= capacity) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+
+  entries.emplace_front(id, description);
+  index[id] = entries.begin();
+}
+
+bool DetailsCache::erase(const std::string &id) {
+  auto found = index.find(id);
+
+  if (found == index.end()) {
+    return false;
+  }
+
+  entries.erase(found->second);
+  index.erase(found);
+
+  return true;
+}
+
+void DetailsCache::clear() {
+  entries.clear();
+  index.clear();
+}
+
+size_t DetailsCache::size() {
+  return entries.size();
+}
@@ -0,0 +1,213 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+
+#include "chk-search.h"
+
+ChkSearch::ChkSearch() {
+
+}
+
+ChkSearch::~ChkSearch() {
+  clear();
+}
+
+uint32_t ChkSearch::trigram(const char *text) {
+  return ((unsigned char)text[0] << 16) |
+    ((unsigned char)text[1] << 8) |
+    (unsigned char)text[2];
+}
+
+/*
+ * Lowercased id and description of every line, separators stay empty.
+ * Built once per list, lines are added to posting lists in order so
+ * every list is sorted.
+ */
+void ChkSearch::build(const std::vector<UnitItem *> &rows) {
+  clear();
+
+  texts.assign(rows.size(), std::string());
+  matches.assign(rows.size(), 0);
+  trigrams.clear();
+
+  for (int row = 0; row < (int)rows.size(); row++) {
+    UnitItem *item = rows[row];
+
+    if (item->id.size() == 0) {
+      continue;
+    }
+
+    std::string &text = texts[row];
+
+    text.assign(item->id.data(), item->id.size());
+    text += '\n';
+    text.append(item->description.data(), item->description.size());
+
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+      std::vector<int> &posting = trigrams[trigram(text.c_str() + i)];
+
+      if (posting.empty() || posting.back() != row) {
+        posting.push_back(row);
+      }
+    }
+  }
+}
+
+/*
+ * Lines that may contain query: the shortest posting list among the
+ * trigrams of the query intersected with the others, or every line
+ * for queries shorter than a trigram
+ */
+void ChkSearch::candidates(const std::string &query, std::vector<int> *found) {
+  std::vector<const std::vector<int> *> postings;
+
+  if (query.size() < 3) {
+    for (int row = 0; row < (int)texts.size(); row++) {
+      if (!texts[row].empty()) {
+        found->push_back(row);
+      }
+    }
+    return;
+  }
+
+  for (size_t i = 0; i + 3 <= query.size(); i++) {
+    auto posting = trigrams.find(trigram(query.c_str() + i));
+
+    if (posting == trigrams.end()) {
+      return;
+    }
+
+    postings.push_back(&posting->second);
+  }
+
+  std::sort(postings.begin(), postings.end(),
+      [](const std::vector<int> *a, const std::vector<int> *b) {
+    return a->size() < b->size();
+  });
+
+  *found = *postings[0];
+
+  for (size_t i = 1; i < postings.size() && !found->empty(); i++) {
+    std::vector<int> narrowed;
+
+    std::set_intersection(found->begin(), found->end(),
+        postings[i]->begin(), postings[i]->end(), std::back_inserter(narrowed));
+    found->swap(narrowed);
+  }
+}
+
+/*
+ * Results of previous queries are kept while the query grows,
+ * going back to a shorter query reuses its result as is.
+ */
+const std::vector<int> &ChkSearch::find(const char *query) {
+  std::string q(query);
+  std::vector<int> found;
+
+  std::transform(q.begin(), q.end(), q.begin(), ::tolower);
+
+  setMatches(false);
+
+  while (!queries.empty() && q.compare(0, queries.back().size(), queries.back()) != 0) {
+    queries.pop_back();
+    results.pop_back();
+  }
+
+  if (q.empty()) {
+    return empty;
+  }
+
+  if (!queries.empty() && queries.back() == q) {
+    setMatches(true);
+    return results.back();
+  }
+
+  if (queries.empty()) {
+    candidates(q, &found);
+  } else {
+    found = results.back();
+  }
+
+  found.erase(std::remove_if(found.begin(), found.end(), [this, &q](int row) {
+    return texts[row].find(q) == std::string::npos;
+  }), found.end());
+
+  queries.push_back(q);
+  results.push_back(found);
+  setMatches(true);
+
+  return results.back();
+}
+
+void ChkSearch::clear() {
+  setMatches(false);
+  queries.clear();
+  results.clear();
+}
+
+void ChkSearch::setMatches(bool value) {
+  if (results.empty()) {
+    return;
+  }
+
+  for (int row : results.back()) {
+    matches[row] = value;
+  }
+}
+
+bool ChkSearch::isMatch(int row) {
+  return row >= 0 && row < (int)matches.size() && matches[row];
+}
+
+size_t ChkSearch::count() {
+  return results.empty() ? 0 : results.back().size();
+}
+
+/*
+ * Closest match after row, wraps around to the first one
+ */
+int ChkSearch::next(int row) {
+  if (count() == 0) {
+    return -1;
+  }
+
+  const std::vector<int> &found = results.back();
+  auto it = std::upper_bound(found.begin(), found.end(), row);
+
+  return it == found.end() ? found.front() : *it;
+}
+
+/*
+ * Closest match before row, wraps around to the last one
+ */
+int ChkSearch::prev(int row) {
+  if (count() == 0) {
+    return -1;
+  }
+
+  const std::vector<int> &found = results.back();
+  auto it = std::lower_bound(found.begin(), found.end(), row);
+
+  return it == found.begin() ? found.back() : *(it - 1);
+}
@@ -0,0 +1,490 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "chk-systemd.h"
+
+#define UNIT_PATH_PREFIX "/org/freedesktop/systemd1/unit"
+
+#define MANAGER_SIGNAL_MATCH(member) \
+  "type='signal',sender='org.freedesktop.systemd1'," \
+  "path='/org/freedesktop/systemd1'," \
+  "interface='org.freedesktop.systemd1.Manager',member='" member "'"
+
+#define PROPERTIES_MATCH \
+  "type='signal',sender='org.freedesktop.systemd1'," \
+  "path_namespace='" UNIT_PATH_PREFIX "'," \
+  "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged'"
+
+typedef struct UnitEventRequest {
+  ChkBus *bus;
+  int type;
+  std::string id;
+} UnitEventRequest;
+
+/*
+ * Asks systemd to send unit signals and installs matches for them.
+ * Matches belong to the connection, so they are installed again
+ * every time the bus is reconnected.
+ */
+void ChkBus::subscribe() {
+  if (subscribed) {
+    return;
+  }
+
+  try {
+    ensureConnected();
+    addMatches();
+  } catch (std::string &err) {
+    throw err;
+  }
+
+  subscribed = true;
+}
+
+void ChkBus::addMatches() {
+  int status;
+  sd_bus_error error = SD_BUS_ERROR_NULL;
+
+  status = sd_bus_add_match(bus, NULL, MANAGER_SIGNAL_MATCH("UnitNew"), onUnitNew, this);
+
+  if (status >= 0) {
+    status = sd_bus_add_match(bus, NULL, MANAGER_SIGNAL_MATCH("UnitRemoved"), onUnitRemoved, this);
+  }
+
+  if (status >= 0) {
+    status = sd_bus_add_match(bus, NULL, MANAGER_SIGNAL_MATCH("JobRemoved"), onJobRemoved, this);
+  }
+
+  if (status >= 0) {
+    status = sd_bus_add_match(bus, NULL, MANAGER_SIGNAL_MATCH("UnitFilesChanged"), onUnitFilesChanged, this);
+  }
+
+  if (status >= 0) {
+    status = sd_bus_add_match(bus, NULL, PROPERTIES_MATCH, onPropertiesChanged, this);
+  }
+
+  if (status < 0) {
+    setErrorMessage(status);
+    goto finish;
+  }
+
+  status = sd_bus_call_method(
+    bus,
+    "org.freedesktop.systemd1",
+    "/org/freedesktop/systemd1",
+    "org.freedesktop.systemd1.Manager",
+    "Subscribe",
+    &error,
+    NULL,
+    NULL);
+
+  if (status < 0) {
+    setErrorMessage(error.message);
+    goto finish;
+  }
+
+  finish:
+    sd_bus_error_free(&error);
+
+    if (status < 0) {
+      throw std::string(errorMessage);
+    }
+}
+
+/*
+ * Descriptor, poll events and absolute CLOCK_MONOTONIC timeout (usec)
+ * an event loop needs to drive the connection
+ */
+int ChkBus::getFd() {
+  return isConnected() ? sd_bus_get_fd(bus) : -1;
+}
+
+int ChkBus::getEvents() {
+  int events = isConnected() ? sd_bus_get_events(bus) : 0;
+
+  return events < 0 ? 0 : events;
+}
+
+uint64_t ChkBus::getTimeout() {
+  uint64_t timeout = (uint64_t) -1;
+
+  if (isConnected() && sd_bus_get_timeout(bus, &timeout) < 0) {
+    timeout = (uint64_t) -1;
+  }
+
+  return timeout;
+}
+
+/*
+ * Dispatches everything that already arrived on the connection
+ * without waiting for more. Returns true if new events were queued.
+ * While subscribed a connection that went away is opened again, with
+ * its matches, so signals keep coming after a dbus or systemd restart.
+ */
+bool ChkBus::processEvents() {
+  int status;
+  size_t queued = events.size();
+
+  if (subscribed && !isOpen()) {
+    ensureConnected();
+  }
+
+  if (!isConnected()) {
+    return false;
+  }
+
+  while ((status = sd_bus_process(bus, NULL)) > 0) {
+    continue;
+  }
+
+  if (status < 0) {
+    setErrorMessage(status);
+    drop();
+
+    if (!subscribed) {
+      throw std::string(errorMessage);
+    }
+
+    ensureConnected();
+  }
+
+  return events.size() > queued;
+}
+
+std::vector<UnitEvent> ChkBus::takeEvents() {
+  std::vector<UnitEvent> taken;
+
+  taken.swap(events);
+
+  return taken;
+}
+
+void ChkBus::pushEvent(int type, const char *id, const char *value) {
+  UnitEvent event;
+
+  event.type = type;
+  event.id = id == NULL ? "" : id;
+  event.value = value == NULL ? "" : value;
+
+  events.push_back(event);
+}
+
+/*
+ * Async unit file state lookup, answered with UNIT_EVENT_STATE
+ */
+void ChkBus::requestState(const char *id) {
+  int status;
+  sd_bus_slot *slot = NULL;
+  UnitEventRequest *request;
+
+  ensureConnected();
+  request = new UnitEventRequest { this, UNIT_EVENT_STATE, id };
+
+  status = sd_bus_call_method_async(
+    bus,
+    &slot,
+    "org.freedesktop.systemd1",
+    "/org/freedesktop/systemd1",
+    "org.freedesktop.systemd1.Manager",
+    "GetUnitFileState",
+    onRequestReply,
+    request,
+    "s",
+    id);
+
+  if (status >= 0) {
+    status = floatRequest(slot);
+  } else {
+    delete request;
+  }
+
+  if (status < 0) {
+    setErrorMessage(status);
+    throw std::string(errorMessage);
+  }
+}
+
+/*
+ * Async unit sub state lookup, answered with UNIT_EVENT_SUB
+ */
+void ChkBus::requestSub(const char *id) {
+  int status;
+  char *path = NULL;
+  sd_bus_slot *slot = NULL;
+  UnitEventRequest *request;
+
+  ensureConnected();
+  request = new UnitEventRequest { this, UNIT_EVENT_SUB, id };
+
+  status = sd_bus_path_encode(UNIT_PATH_PREFIX, id, &path);
+
+  if (status >= 0) {
+    status = sd_bus_call_method_async(
+      bus,
+      &slot,
+      "org.freedesktop.systemd1",
+      path,
+      "org.freedesktop.DBus.Properties",
+      "Get",
+      onRequestReply,
+      request,
+      "ss",
+      "org.freedesktop.systemd1.Unit",
+      "SubState");
+  }
+
+  free(path);
+
+  if (status >= 0) {
+    status = floatRequest(slot);
+  } else {
+    delete request;
+  }
+
+  if (status < 0) {
+    setErrorMessage(status);
+    throw std::string(errorMessage);
+  }
+}
+
+/*
+ * Async lookup of unit properties ListUnitFiles has not, answered with
+ * UNIT_EVENT_DETAILS. systemd loads the unit to answer, the event comes
+ * with an empty value when it could not.
+ */
+void ChkBus::requestDetails(const char *id) {
+  int status;
+  char *path = NULL;
+  sd_bus_slot *slot = NULL;
+  UnitEventRequest *request;
+
+  ensureConnected();
+  request = new UnitEventRequest { this, UNIT_EVENT_DETAILS, id };
+
+  status = sd_bus_path_encode(UNIT_PATH_PREFIX, id, &path);
+
+  if (status >= 0) {
+    status = sd_bus_call_method_async(
+      bus,
+      &slot,
+      "org.freedesktop.systemd1",
+      path,
+      "org.freedesktop.DBus.Properties",
+      "GetAll",
+      onRequestReply,
+      request,
+      "s",
+      "org.freedesktop.systemd1.Unit");
+  }
+
+  free(path);
+
+  if (status >= 0) {
+    status = floatRequest(slot);
+  } else {
+    delete request;
+  }
+
+  if (status < 0) {
+    setErrorMessage(status);
+    throw std::string(errorMessage);
+  }
+}
+
+/*
+ * Takes Description out of a GetAll reply
+ */
+static int readDescription(sd_bus_message *reply, const char **value) {
+  const char *property = NULL;
+  int status;
+
+  status = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "{sv}");
+
+  while (status > 0 &&
+      (status = sd_bus_message_enter_container(reply, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+    status = sd_bus_message_read(reply, "s", &property);
+
+    if (status > 0 && strcmp(property, "Description") == 0) {
+      return sd_bus_message_read(reply, "v", "s", value);
+    }
+
+    if (status > 0) {
+      status = sd_bus_message_skip(reply, "v");
+    }
+
+    if (status >= 0) {
+      status = sd_bus_message_exit_container(reply);
+    }
+  }
+
+  return status;
+}
+
+int ChkBus::onRequestReply(sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+  UnitEventRequest *request = (UnitEventRequest *)userdata;
+  const char *value = NULL;
+  int status;
+
+  assert(request);
+
+  /*
+   * The call timed out or the connection went away before the answer,
+   * whoever asked may ask again
+   */
+  if (sd_bus_message_is_method_error(reply, SD_BUS_ERROR_NO_REPLY)) {
+    request->bus->pushEvent(UNIT_EVENT_NO_REPLY, request->id.c_str(), NULL);
+    return 0;
+  }
+
+  if (request->type == UNIT_EVENT_DETAILS) {
+    if (sd_bus_message_is_method_error(reply, NULL) || readDescription(reply, &value) <= 0) {
+      value = NULL;
+    }
+
+    request->bus->pushEvent(request->type, request->id.c_str(), value);
+  } else if (!sd_bus_message_is_method_error(reply, NULL)) {
+    if (request->type == UNIT_EVENT_SUB) {
+      status = sd_bus_message_read(reply, "v", "s", &value);
+    } else {
+      status = sd_bus_message_read(reply, "s", &value);
+    }
+
+    if (status > 0) {
+      request->bus->pushEvent(request->type, request->id.c_str(), value);
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * The request goes with the slot of its call, freeRequest() frees it
+ * after the reply or when the connection is dropped before one came.
+ * A slot that could not take the callback cancels the call on unref,
+ * its request is freed here.
+ */
+int ChkBus::floatRequest(sd_bus_slot *slot) {
+  void *request = sd_bus_slot_get_userdata(slot);
+  int status = sd_bus_slot_set_destroy_callback(slot, freeRequest);
+  bool owned = status >= 0;
+
+  if (owned) {
+    status = sd_bus_slot_set_floating(slot, 1);
+  }
+
+  sd_bus_slot_unref(slot);
+
+  if (!owned) {
+    freeRequest(request);
+  }
+
+  return status;
+}
+
+void ChkBus::freeRequest(void *userdata) {
+  delete (UnitEventRequest *)userdata;
+}
+
+int ChkBus::onUnitNew(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  const char *id = NULL;
+
+  if (sd_bus_message_read(message, "so", &id, NULL) > 0) {
+    ((ChkBus *)userdata)->pushEvent(UNIT_EVENT_NEW, id, NULL);
+  }
+
+  return 0;
+}
+
+int ChkBus::onUnitRemoved(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  const char *id = NULL;
+
+  if (sd_bus_message_read(message, "so", &id, NULL) > 0) {
+    ((ChkBus *)userdata)->pushEvent(UNIT_EVENT_REMOVED, id, NULL);
+  }
+
+  return 0;
+}
+
+int ChkBus::onJobRemoved(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  const char *id = NULL;
+  const char *result = NULL;
+
+  if (sd_bus_message_read(message, "uoss", NULL, NULL, &id, &result) > 0) {
+    ((ChkBus *)userdata)->pushEvent(UNIT_EVENT_JOB, id, result);
+  }
+
+  return 0;
+}
+
+int ChkBus::onUnitFilesChanged(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  ((ChkBus *)userdata)->pushEvent(UNIT_EVENT_FILES, NULL, NULL);
+
+  return 0;
+}
+
+/*
+ * Only SubState is taken from the changed unit properties, any change
+ * drops the details loaded for the unit with UNIT_EVENT_CHANGED
+ */
+int ChkBus::onPropertiesChanged(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  const char *interface = NULL;
+  const char *property = NULL;
+  const char *value = NULL;
+  char *id = NULL;
+
+  if (sd_bus_path_decode(sd_bus_message_get_path(message), UNIT_PATH_PREFIX, &id) <= 0) {
+    return 0;
+  }
+
+  if (sd_bus_message_read(message, "s", &interface) <= 0 ||
+      strcmp(interface, "org.freedesktop.systemd1.Unit") != 0) {
+    goto finish;
+  }
+
+  ((ChkBus *)userdata)->pushEvent(UNIT_EVENT_CHANGED, id, NULL);
+
+  if (sd_bus_message_enter_container(message, SD_BUS_TYPE_ARRAY, "{sv}") <= 0) {
+    goto finish;
+  }
+
+  while (sd_bus_message_enter_container(message, SD_BUS_TYPE_DICT_ENTRY, "sv") > 0) {
+    if (sd_bus_message_read(message, "s", &property) <= 0) {
+      break;
+    }
+
+    if (strcmp(property, "SubState") == 0) {
+      if (sd_bus_message_read(message, "v", "s", &value) > 0) {
+        ((ChkBus *)userdata)->pushEvent(UNIT_EVENT_SUB, id, value);
+      }
+    } else if (sd_bus_message_skip(message, "v") < 0) {
+      break;
+    }
+
+    sd_bus_message_exit_container(message);
+  }
+
+  finish:
+    free(id);
+
+  return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "chk-systemd.h"
+
+#define INDEX_EMPTY -1
+#define INDEX_REMOVED -2
+
+/*
+ * FNV-1a, one character at a time
+ */
+uint64_t UnitIndex::hashStep(uint64_t hash, char c) {
+  return (hash ^ (unsigned char)c) * 1099511628211ULL;
+}
+
+UnitIndex::UnitIndex(std::vector<UnitInfo *> *files) {
+  size_t capacity = 16;
+
+  this->files = files;
+
+  /*
+   * Room for every file to be renamed once before the first rehash,
+   * renamed entries leave a removed slot behind
+   */
+  while (capacity < files->size() * 4) {
+    capacity <<= 1;
+  }
+
+  slots.assign(capacity, Slot { 0, 0, INDEX_EMPTY });
+  mask = capacity - 1;
+
+  for (int idx = 0; idx < (int)files->size(); idx++) {
+    insert(idx);
+  }
+}
+
+UnitIndex::~UnitIndex() {
+  slots.clear();
+  lengths.clear();
+}
+
+void UnitIndex::insert(int idx) {
+  const char *id = (*files)[idx]->id;
+  uint64_t hash = 14695981039346656037ULL;
+  size_t length = 0;
+
+  for (; id[length] != 0; length++) {
+    hash = hashStep(hash, id[length]);
+  }
+
+  if (lengths.size() <= length) {
+    lengths.resize(length + 1, false);
+  }
+  lengths[length] = true;
+
+  /*
+   * Used slots, removed ones included, are kept under 3/4 of the table,
+   * so the probe always finds a free slot
+   */
+  if ((used + 1) * 4 > slots.size() * 3) {
+    rehash();
+  }
+
+  size_t pos = hash & mask;
+
+  while (slots[pos].idx >= 0) {
+    pos = (pos + 1) & mask;
+  }
+
+  if (slots[pos].idx == INDEX_EMPTY) {
+    used++;
+  }
+
+  slots[pos].hash = hash;
+  slots[pos].length = length;
+  slots[pos].idx = idx;
+}
+
+/*
+ * Builds the table again without removed slots, larger when the entries
+ * left would fill half of it
+ */
+void UnitIndex::rehash() {
+  std::vector<Slot> entries;
+  size_t capacity = slots.size();
+
+  for (auto &slot : slots) {
+    if (slot.idx >= 0) {
+      entries.push_back(slot);
+    }
+  }
+
+  while ((entries.size() + 1) * 2 > capacity) {
+    capacity <<= 1;
+  }
+
+  slots.assign(capacity, Slot { 0, 0, INDEX_EMPTY });
+  mask = capacity - 1;
+  used = entries.size();
+
+  for (auto &entry : entries) {
+    size_t pos = entry.hash & mask;
+
+    while (slots[pos].idx != INDEX_EMPTY) {
+      pos = (pos + 1) & mask;
+    }
+
+    slots[pos] = entry;
+  }
+}
+
+/*
+ * Returns the first unit file (in list order) whose id is a prefix
+ * of the given unit id, or -1. The slot holding it is stored in slot.
+ */
+int UnitIndex::findPrefix(const char *id, size_t *slot) {
+  uint64_t hash = 14695981039346656037ULL;
+  int found = INDEX_EMPTY;
+
+  for (size_t length = 1; id[length - 1] != 0; length++) {
+    hash = hashStep(hash, id[length - 1]);
+
+    if (length >= lengths.size()) {
+      break;
+    }
+
+    if (!lengths[length]) {
+      continue;
+    }
+
+    for (size_t pos = hash & mask; slots[pos].idx != INDEX_EMPTY;
+        pos = (pos + 1) & mask) {
+      const Slot &entry = slots[pos];
+
+      if (entry.idx < 0 || entry.hash != hash || entry.length != length) {
+        continue;
+      }
+
+      if ((found < 0 || entry.idx < found) &&
+          memcmp((*files)[entry.idx]->id, id, length) == 0) {
+        found = entry.idx;
+        *slot = pos;
+      }
+    }
+  }
+
+  return found;
+}
+
+/*
+ * Replaces the id of the unit file found at slot,
+ * the entry is moved under its new id.
+ */
+void UnitIndex::rename(size_t slot, const char *id) {
+  int idx = slots[slot].idx;
+
+  slots[slot].idx = INDEX_REMOVED;
+  (*files)[idx]->id = id;
+  insert(idx);
+}
+
+/*
+ * Attaches loaded units to their unit files. A unit belongs to the first
+ * unit file whose id is a prefix of the unit id, units without one are
+ * moved to orphans. Merged units are freed unless they live in arena.
+ */
+void ChkBus::mergeUnits(std::vector<UnitInfo *> *files,
+    std::vector<UnitInfo *> *units, std::vector<UnitInfo *> *orphans,
+    UnitArena *arena) {
+  UnitIndex index(files);
+
+  for (auto unit : (*units)) {
+    size_t slot = 0;
+    int idx = index.findPrefix(unit->id, &slot);
+
+    if (idx < 0) {
+      orphans->push_back(unit);
+      continue;
+    }
+
+    UnitInfo *file = (*files)[idx];
+
+    if (arena == NULL) {
+      const char *state = file->state;
+
+      file->state = NULL;
+      freeUnitInfo(file);
+      file->state = state;
+    }
+
+    file->unitPath = unit->unitPath;
+    file->description = unit->description;
+    file->loadState = unit->loadState;
+    file->subState = unit->subState;
+    index.rename(slot, unit->id);
+
+    if (arena == NULL) {
+      free((void *)unit->state);
+      delete unit;
+    }
+  }
+}
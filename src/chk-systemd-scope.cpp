@@ -0,0 +1,153 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <fnmatch.h>
+
+#include "chk-systemd.h"
+
+/*
+ * States ListUnitFilesByPatterns filters on, any other state is
+ * a load, active or sub state for ListUnitsByPatterns
+ */
+static const char *fileStates[] = {
+  "enabled", "enabled-runtime", "linked", "linked-runtime", "alias",
+  "masked", "masked-runtime", "static", "disabled", "indirect",
+  "generated", "transient", "bad", "invalid", NULL
+};
+
+static bool isFileState(const std::string &state) {
+  for (int i = 0; fileStates[i] != NULL; i++) {
+    if (state == fileStates[i]) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool hasString(const std::vector<std::string> &values, const char *value) {
+  for (auto &item : values) {
+    if (value != NULL && item == value) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Types become name suffixes of the patterns: app-* with service and
+ * timer types is app-*.service and app-*.timer. A pattern that already
+ * has a suffix is kept as it is.
+ */
+void ChkBus::setScope(const UnitScope &scope) {
+  std::vector<std::string> names = scope.patterns;
+
+  scopePatterns.clear();
+  scopeFileStates.clear();
+  scopeUnitStates.clear();
+
+  scoped = !scope.types.empty() || !scope.states.empty() || !scope.patterns.empty();
+
+  if (names.empty() && !scope.types.empty()) {
+    names.push_back("*");
+  }
+
+  for (auto &name : names) {
+    if (scope.types.empty() || name.find('.') != std::string::npos) {
+      scopePatterns.push_back(name);
+      continue;
+    }
+
+    for (auto &type : scope.types) {
+      scopePatterns.push_back(name + "." + type);
+    }
+  }
+
+  for (auto &state : scope.states) {
+    if (isFileState(state)) {
+      scopeFileStates.push_back(state);
+    } else {
+      scopeUnitStates.push_back(state);
+    }
+  }
+}
+
+bool ChkBus::isScoped() {
+  return scoped;
+}
+
+/*
+ * Names only, units that show up later are not asked for their states
+ */
+bool ChkBus::inScope(const char *id) {
+  if (scopePatterns.empty()) {
+    return true;
+  }
+
+  for (auto &pattern : scopePatterns) {
+    if (fnmatch(pattern.c_str(), id, FNM_NOESCAPE) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Keeps units of list that keep returns true for, the others are
+ * freed unless they live in arena
+ */
+template <typename Keep>
+static void keepUnits(std::vector<UnitInfo *> *list, UnitArena *arena, Keep keep) {
+  size_t kept = 0;
+
+  for (auto unit : (*list)) {
+    if (keep(unit)) {
+      (*list)[kept++] = unit;
+    } else if (arena == NULL) {
+      ChkBus::freeUnitInfo(unit);
+      delete unit;
+    }
+  }
+
+  list->resize(kept);
+}
+
+/*
+ * Each list was filtered by systemd on its own kind of states. With
+ * runtime states only unit files of matching loaded units stay, with
+ * unit file states only loaded units whose unit file state matches.
+ */
+void ChkBus::filterScope(std::vector<UnitInfo *> *files,
+    std::vector<UnitInfo *> *orphans, UnitArena *arena) {
+  if (!scopeUnitStates.empty()) {
+    keepUnits(files, arena, [](UnitInfo *unit) {
+      return unit->loadState != NULL;
+    });
+  }
+
+  if (!scopeFileStates.empty()) {
+    keepUnits(orphans, arena, [this](UnitInfo *unit) {
+      return hasString(scopeFileStates, unit->state);
+    });
+  }
+}
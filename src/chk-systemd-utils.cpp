@@ -20,6 +20,8 @@
 
 #include "chk-systemd.h"
 #include <cassert>
+#include <cstring>
+#include <new>
 #include <unistd.h>
 #include <sys/wait.h>
 
@@ -42,6 +44,69 @@ int busParseUnit(sd_bus_message *message, UnitInfo *u) {
     NULL);
 }
 
+/*
+ * Appends values as an array of strings
+ */
+int busAppendStrings(sd_bus_message *message, const std::vector<std::string> &values) {
+  int status = sd_bus_message_open_container(message, SD_BUS_TYPE_ARRAY, "s");
+
+  for (size_t i = 0; status >= 0 && i < values.size(); i++) {
+    status = sd_bus_message_append(message, "s", values[i].c_str());
+  }
+
+  if (status >= 0) {
+    status = sd_bus_message_close_container(message);
+  }
+
+  return status;
+}
+
+UnitInfo *busNewUnit(UnitArena *arena) {
+  if (arena == NULL) {
+    return new UnitInfo();
+  }
+
+  return new (arena->alloc(sizeof(UnitInfo))) UnitInfo();
+}
+
+const char *busCopy(UnitArena *arena, const char *value) {
+  if (arena == NULL) {
+    return value == NULL ? NULL : strdup(value);
+  }
+
+  return arena->copy(value);
+}
+
+/*
+ * States and types repeat for most units, the arena keeps one copy
+ */
+const char *busIntern(UnitArena *arena, const char *value) {
+  if (arena == NULL) {
+    return value == NULL ? NULL : strdup(value);
+  }
+
+  return arena->intern(value);
+}
+
+int busOnUnitState(sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+  UnitStateRequest *request = (UnitStateRequest *)userdata;
+  const char *state = NULL;
+
+  assert(request);
+
+  (*request->pending)--;
+
+  if (sd_bus_message_is_method_error(reply, NULL)) {
+    return 0;
+  }
+
+  if (sd_bus_message_read(reply, "s", &state) > 0) {
+    request->unit->state = busIntern(request->arena, state);
+  }
+
+  return 0;
+}
+
 void applySYSv(const char *state, const char **names) {
   int pid = fork();
   int status;
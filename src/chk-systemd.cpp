@@ -21,6 +21,9 @@
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
 
 #include "chk-systemd.h"
 
@@ -49,10 +52,67 @@ bool ChkBus::connect() {
     throw std::string(errorMessage);
   }
 
+  stats.connects++;
+  dropped = false;
+
+  if (subscribed) {
+    addMatches();
+  }
+
   return isConnected();
 }
 
+/*
+ * Reuses the current connection while it is open.
+ * A dropped connection is opened again, waiting a bit longer
+ * after every failed attempt. Signals sent meanwhile are lost,
+ * a subscribed bus queues UNIT_EVENT_RECONNECT for that.
+ */
+void ChkBus::ensureConnected() {
+  int delay = BUS_RECONNECT_DELAY;
+
+  if (isOpen()) {
+    stats.reuses++;
+    return;
+  }
+
+  if (!isConnected() && !dropped) {
+    connect();
+    return;
+  }
+
+  stats.reconnects++;
+
+  for (int attempt = 1; ; attempt++) {
+    try {
+      connect();
+
+      if (subscribed) {
+        pushEvent(UNIT_EVENT_RECONNECT, NULL, NULL);
+      }
+      return;
+    } catch (std::string &err) {
+      if (attempt >= BUS_RECONNECT_ATTEMPTS) {
+        throw err;
+      }
+    }
+
+    usleep(delay * 1000);
+    delay *= 2;
+  }
+}
+
+ChkBusStats ChkBus::getStats() {
+  return stats;
+}
+
+/*
+ * Calls in flight go away with the connection
+ */
 void ChkBus::disconnect() {
+  dropList(&fileList);
+  dropList(&unitList);
+
   if (bus != NULL) {
     sd_bus_unref(bus);
     bus = NULL;
@@ -63,6 +123,19 @@ bool ChkBus::isConnected() {
   return bus == NULL ? false : true;
 }
 
+bool ChkBus::isOpen() {
+  return isConnected() && sd_bus_is_open(bus) > 0;
+}
+
+/*
+ * The connection failed under a call, the next ensureConnected()
+ * opens it again as a reconnect
+ */
+void ChkBus::drop() {
+  disconnect();
+  dropped = true;
+}
+
 void ChkBus::setErrorMessage(int status) {
   errorMessage = (char *)ERR_PREFIX;
 
@@ -78,67 +151,73 @@ void ChkBus::setErrorMessage(const char *message) {
   errorMessage += message;
 }
 
-const char *ChkBus::getState(const char *name) {
+static int readUnitFiles(sd_bus_message *reply, UnitArena *arena,
+    std::vector<UnitInfo *> *units) {
   int status;
   const char *state;
+  char *path;
 
-  errorMessage.clear();
+  status = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ss)");
 
-  if (!isConnected()) {
-    connect();
+  if (status < 0) {
+    return status;
   }
 
-  sd_bus_message *busMessage = NULL;
-  sd_bus_error error = SD_BUS_ERROR_NULL;
+  while ((status = sd_bus_message_read(reply, "(ss)", &path, &state)) > 0) {
+    UnitInfo *unit = busNewUnit(arena);
+    const char *name = strrchr(path, '/');
 
-  status = sd_bus_call_method(
-    bus,
-    "org.freedesktop.systemd1",
-    "/org/freedesktop/systemd1",
-    "org.freedesktop.systemd1.Manager",
-    "GetUnitFileState",
-    &error,
-    &busMessage,
-    "s",
-    name);
+    unit->unitPath = busCopy(arena, path);
+    unit->state = busIntern(arena, state);
+    unit->id = busCopy(arena, name == NULL ? path : name + 1);
 
-  if (status < 0) {
-    setErrorMessage(error.message);
-    goto finish;
+    units->push_back(unit);
+
+    path = NULL;
+    state = NULL;
   }
 
-  status = sd_bus_message_read(busMessage, "s", &state);
+  return status < 0 ? status : sd_bus_message_exit_container(reply);
+}
+
+static int readUnits(sd_bus_message *reply, UnitArena *arena,
+    std::vector<UnitInfo *> *units) {
+  int status;
+  UnitInfo unit;
+
+  status = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
 
   if (status < 0) {
-    setErrorMessage(status);
-    goto finish;
+    return status;
   }
 
-  finish:
-    sd_bus_error_free(&error);
-    sd_bus_message_unref(busMessage);
-    if (state < 0) {
-      throw std::string(errorMessage);
-    }
+  while ((status = busParseUnit(reply, &unit)) > 0) {
+    UnitInfo *u = busNewUnit(arena);
+
+    u->id = busCopy(arena, unit.id);
+    u->description = busCopy(arena, unit.description);
+    u->loadState = busIntern(arena, unit.loadState);
+    u->subState = busIntern(arena, unit.subState);
+    u->unitPath = busCopy(arena, unit.unitPath);
+
+    units->push_back(u);
+  }
 
-  return status < 0 ? NULL : strdup(state);
+  return status < 0 ? status : sd_bus_message_exit_container(reply);
 }
 
-std::vector<UnitInfo *> ChkBus::getUnitFiles() {
+/*
+ * Sends ListUnitFiles or ListUnits, narrowed to the scope when there
+ * is one. A previous reply nobody took is dropped.
+ */
+void ChkBus::callList(UnitListRequest *request, UnitArena *arena) {
   int status;
-  const char *state;
-  char *path;
-  std::vector<UnitInfo *> units;
-
-  sd_bus_message* busMessage = NULL;
-  sd_bus_message* reply = NULL;
-  sd_bus_error error = SD_BUS_ERROR_NULL;
+  sd_bus_message *busMessage = NULL;
 
   errorMessage.clear();
 
-  if (!isConnected()) {
-    connect();
-  }
+  ensureConnected();
+  dropList(request);
 
   status = sd_bus_message_new_method_call(
     bus,
@@ -146,191 +225,281 @@ std::vector<UnitInfo *> ChkBus::getUnitFiles() {
     "org.freedesktop.systemd1",
     "/org/freedesktop/systemd1",
     "org.freedesktop.systemd1.Manager",
-    "ListUnitFiles");
+    request->files ?
+      (scoped ? "ListUnitFilesByPatterns" : "ListUnitFiles") :
+      (scoped ? "ListUnitsByPatterns" : "ListUnits"));
 
-  if (status < 0) {
-    setErrorMessage(status);
-    goto finish;
+  if (status >= 0 && scoped) {
+    status = busAppendStrings(busMessage, request->files ? scopeFileStates : scopeUnitStates);
   }
 
-  status = sd_bus_call(bus, busMessage, 0, &error, &reply);
+  if (status >= 0 && scoped) {
+    status = busAppendStrings(busMessage, scopePatterns);
+  }
 
-  if (status < 0) {
-    setErrorMessage(error.message);
-    goto finish;
+  if (status >= 0) {
+    status = sd_bus_call_async(bus, &request->slot, busMessage, onListReply, request, 0);
   }
 
-  status = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ss)");
+  sd_bus_message_unref(busMessage);
 
   if (status < 0) {
     setErrorMessage(status);
-    goto finish;
+    throw std::string(errorMessage);
   }
 
-  while ((status = sd_bus_message_read(reply, "(ss)", &path, &state)) > 0) {
-    UnitInfo *unit = new UnitInfo();
-
-    unit->unitPath = strdup(path);
-    unit->state = strdup(state);
+  request->arena = arena;
+  request->state = UNIT_LIST_PENDING;
+}
 
-    std::string p = std::string(unit->unitPath);
-    unit->id = strdup(p.substr(p.find_last_of("/") + 1, p.length()).c_str());
+int ChkBus::onListReply(sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+  UnitListRequest *request = (UnitListRequest *)userdata;
+  const sd_bus_error *replyError = sd_bus_message_get_error(reply);
 
-    units.push_back(unit);
+  assert(request);
 
-    path = NULL;
-    state = NULL;
+  if (replyError != NULL) {
+    request->status = -EIO;
+    request->error = replyError->message == NULL ? replyError->name : replyError->message;
+  } else if (request->files) {
+    request->status = readUnitFiles(reply, request->arena, &request->units);
+  } else {
+    request->status = readUnits(reply, request->arena, &request->units);
   }
 
-  status = sd_bus_message_exit_container(reply);
+  request->state = UNIT_LIST_DONE;
 
-  if (status < 0) {
-    setErrorMessage(status);
-    goto finish;
-  }
+  return 0;
+}
 
-  finish:
-    sd_bus_error_free(&error);
-    sd_bus_message_unref(busMessage);
-    sd_bus_message_unref(reply);
-    disconnect();
+/*
+ * Processes the connection until the reply of request came
+ */
+std::vector<UnitInfo *> ChkBus::waitList(UnitListRequest *request) {
+  int status = 0;
+  std::vector<UnitInfo *> units;
+
+  while (request->state == UNIT_LIST_PENDING) {
+    status = sd_bus_process(bus, NULL);
+
+    if (status > 0) {
+      continue;
+    }
+
+    if (status == 0) {
+      status = sd_bus_wait(bus, (uint64_t) -1);
+    }
 
     if (status < 0) {
+      setErrorMessage(status);
+      drop();
       throw std::string(errorMessage);
     }
+  }
+
+  if (request->state == UNIT_LIST_IDLE) {
+    setErrorMessage(ECONNRESET);
+    throw std::string(errorMessage);
+  }
+
+  if (request->status < 0) {
+    if (request->error.empty()) {
+      setErrorMessage(request->status);
+    } else {
+      setErrorMessage(request->error.c_str());
+    }
+
+    dropList(request);
+    throw std::string(errorMessage);
+  }
+
+  units.swap(request->units);
+  dropList(request);
 
   return units;
 }
 
-std::vector<UnitInfo *> ChkBus::getUnits() {
-  int status;
-  UnitInfo unit;
-  std::vector<UnitInfo *> units;
+/*
+ * Cancels the call if it is still in flight, units of a reply
+ * without an arena are freed one by one
+ */
+void ChkBus::dropList(UnitListRequest *request) {
+  if (request->arena == NULL) {
+    for (auto unit : request->units) {
+      freeUnitInfo(unit);
+      delete unit;
+    }
+  }
 
-  sd_bus_message* busMessage = NULL;
-  sd_bus_message* reply = NULL;
-  sd_bus_error error = SD_BUS_ERROR_NULL;
+  request->units.clear();
+  request->slot = sd_bus_slot_unref(request->slot);
+  request->state = UNIT_LIST_IDLE;
+  request->status = 0;
+  request->error.clear();
+}
 
-  errorMessage.clear();
+std::vector<UnitInfo *> ChkBus::getUnitFiles(UnitArena *arena) {
+  callList(&fileList, arena);
 
-  if (!isConnected()) {
-    connect();
-  }
+  return waitList(&fileList);
+}
 
-  status = sd_bus_message_new_method_call(
-    bus,
-    &busMessage,
-    "org.freedesktop.systemd1",
-    "/org/freedesktop/systemd1",
-    "org.freedesktop.systemd1.Manager",
-    "ListUnits"
-  );
+std::vector<UnitInfo *> ChkBus::listUnits(UnitArena *arena) {
+  callList(&unitList, arena);
 
-  if (status < 0) {
-    setErrorMessage(status);
-    goto finish;
-  }
+  return waitList(&unitList);
+}
 
-  status = sd_bus_call(bus, busMessage, 0, &error, &reply);
+void ChkBus::requestUnits(UnitArena *arena) {
+  callList(&unitList, arena);
+}
 
-  if (status < 0) {
-    setErrorMessage(error.message);
-    goto finish;
+std::vector<UnitInfo *> ChkBus::takeUnits(UnitArena *arena) {
+  if (unitList.state == UNIT_LIST_IDLE) {
+    return listUnits(arena);
   }
 
-  status = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
+  return waitList(&unitList);
+}
 
-  if (status < 0) {
-    setErrorMessage(status);
-    goto finish;
+/*
+ * Fills unit file state of the given units.
+ * GetUnitFileState calls are pipelined on a single connection, keeping
+ * at most BUS_PIPELINE_DEPTH of them in flight, so the whole batch costs
+ * a few round trips instead of one per unit.
+ */
+void ChkBus::getStates(std::vector<UnitInfo *> *units, UnitArena *arena) {
+  int status = 0;
+  int pending = 0;
+  size_t next = 0;
+  std::vector<UnitStateRequest> requests(units->size());
+
+  errorMessage.clear();
+
+  if (units->empty()) {
+    return;
   }
 
-  while ((status = busParseUnit(reply, &unit)) > 0) {
-    UnitInfo *u = new UnitInfo();
+  ensureConnected();
+
+  while (next < units->size() || pending > 0) {
+    while (next < units->size() && pending < BUS_PIPELINE_DEPTH) {
+      requests[next].unit = (*units)[next];
+      requests[next].pending = &pending;
+      requests[next].arena = arena;
+
+      status = sd_bus_call_method_async(
+        bus,
+        NULL,
+        "org.freedesktop.systemd1",
+        "/org/freedesktop/systemd1",
+        "org.freedesktop.systemd1.Manager",
+        "GetUnitFileState",
+        busOnUnitState,
+        &requests[next],
+        "s",
+        (*units)[next]->id);
+
+      if (status < 0) {
+        setErrorMessage(status);
+        goto finish;
+      }
 
-    u->id = strdup(unit.id);
-    u->description = strdup(unit.description);
-    u->loadState = strdup(unit.loadState);
-    u->subState = strdup(unit.subState);
-    u->unitPath = strdup(unit.unitPath);
+      pending++;
+      next++;
+    }
 
-    try {
-      u->state = getState(unit.id);
-    } catch (std::string &err) {
-      break;
+    status = sd_bus_process(bus, NULL);
+
+    if (status < 0) {
+      setErrorMessage(status);
+      goto finish;
     }
 
-    units.push_back(u);
-  }
+    if (status > 0) {
+      continue;
+    }
 
-  status = sd_bus_message_exit_container(reply);
+    status = sd_bus_wait(bus, (uint64_t) -1);
 
-  if (status < 0) {
-    setErrorMessage(status);
-    goto finish;
+    if (status < 0) {
+      setErrorMessage(status);
+      goto finish;
+    }
   }
 
   finish:
-    sd_bus_error_free(&error);
-    sd_bus_message_unref(busMessage);
-    sd_bus_message_unref(reply);
-    disconnect();
-
     if (status < 0) {
+      /*
+       * Dropping the connection also drops the calls still in flight,
+       * their callbacks must not outlive requests
+       */
+      drop();
       throw std::string(errorMessage);
     }
+}
+
+std::vector<UnitInfo *> ChkBus::getUnits(UnitArena *arena) {
+  std::vector<UnitInfo *> units;
+
+  try {
+    units = listUnits(arena);
+    getStates(&units, arena);
+  } catch (std::string &err) {
+    throw err;
+  }
 
   return units;
 }
 
+/*
+ * Frees the strings of a unit fetched without an arena,
+ * the unit itself is left to the caller
+ */
 void ChkBus::freeUnitInfo(UnitInfo *unit) {
   free((void *)unit->id);
   free((void *)unit->unitPath);
   free((void *)unit->description);
   free((void *)unit->loadState);
+  free((void *)unit->activeState);
   free((void *)unit->subState);
+  free((void *)unit->state);
 }
 
-std::vector<UnitInfo *> ChkBus::getAllUnits() {
+std::vector<UnitInfo *> ChkBus::getAllUnits(UnitArena *arena) {
   std::vector<UnitInfo *> files;
   std::vector<UnitInfo *> units;
+  std::vector<UnitInfo *> orphans;
 
+  /*
+   * Both lists are asked for at once, each reply is parsed as it comes
+   */
   try {
-    files = getUnitFiles();
-    units = getUnits();
+    callList(&fileList, arena);
+    callList(&unitList, arena);
+    files = waitList(&fileList);
+    units = waitList(&unitList);
   } catch(std::string &err) {
     throw err;
   }
 
-  for (auto unit : units) {
-    int idx = 0;
-    bool found = false;
-    for (auto file : files) {
-      std::string uid(unit->id);
-      std::string fid(file->id);
+  mergeUnits(&files, &units, &orphans, arena);
 
-      if (uid.find(fid) == 0) {
-        freeUnitInfo(files[idx]);
-
-        files[idx]->id = unit->id;
-        files[idx]->unitPath = unit->unitPath;
-        files[idx]->description = unit->description;
-        files[idx]->loadState = unit->loadState;
-        files[idx]->subState = unit->subState;
-
-        found = true;
-        break;
-      }
-      idx++;
-    }
+  /*
+   * Only units without a unit file need their state asked separately
+   */
+  try {
+    getStates(&orphans, arena);
+  } catch(std::string &err) {
+    throw err;
+  }
 
-    if (!found) {
-      files.push_back(unit);
-    } else {
-      delete unit;
-    }
+  if (scoped) {
+    filterScope(&files, &orphans, arena);
   }
 
+  files.insert(files.end(), orphans.begin(), orphans.end());
+
   units.clear();
   units.shrink_to_fit();
   return files;
@@ -342,9 +511,7 @@ void ChkBus::reloadDaemon() {
   sd_bus_message* busMessage = NULL;
   sd_bus_error error = SD_BUS_ERROR_NULL;
 
-  if (!isConnected()) {
-    connect();
-  }
+  ensureConnected();
 
   status  = sd_bus_message_new_method_call(
     bus,
@@ -365,7 +532,6 @@ void ChkBus::reloadDaemon() {
   finish:
     sd_bus_error_free(&error);
     sd_bus_message_unref(busMessage);
-    disconnect();
 
     if (status < 0) {
       throw std::string(errorMessage);
@@ -374,14 +540,11 @@ void ChkBus::reloadDaemon() {
 
 void ChkBus::applyUnitState(const char *method, char **names, int flags) {
   int status;
-  bool checkState = false;
 
   sd_bus_error error = SD_BUS_ERROR_NULL;
   sd_bus_message *busMessage = NULL;
 
-  if (!isConnected()) {
-    connect();
-  }
+  ensureConnected();
 
   status = sd_bus_message_new_method_call(
     bus,
@@ -409,11 +572,9 @@ void ChkBus::applyUnitState(const char *method, char **names, int flags) {
       break;
     case STATE_FLAGS_DISABLE:
       status = sd_bus_message_append(busMessage, "b", true);
-      checkState = true;
       break;
     case STATE_FLAGS_DISABLE_ISO:
       status = sd_bus_message_append(busMessage, "b", false);
-      checkState = true;
       break;
     default:
       break;
@@ -440,32 +601,44 @@ void ChkBus::applyUnitState(const char *method, char **names, int flags) {
   finish:
     sd_bus_error_free(&error);
     sd_bus_message_unref(busMessage);
-    disconnect();
 
     if (status < 0) {
       throw std::string(errorMessage);
     }
-
-  if (checkState) {
-    checkDisabledStatus(names);
-  }
 }
 
+/*
+ * Units still enabled after a disable are disabled once more, only once
+ * and only those. Their states are read in one pipelined batch.
+ */
 void ChkBus::checkDisabledStatus(char **names) {
+  UnitArena arena;
+  std::vector<UnitInfo *> units;
+  std::vector<char *> enabled;
+
+  for (int i = 0; names[i] != NULL; i++) {
+    UnitInfo *unit = busNewUnit(&arena);
+
+    unit->id = names[i];
+    units.push_back(unit);
+  }
+
   try {
-    for (int i = 0; names[i] != NULL; i++) {
-      const char *name = names[i];
-      const char *state = getState(name);
+    getStates(&units, &arena);
 
-      if (std::string(state).find("enabled") == 0) {
-        applyUnitState("DisableUnitFiles", names, STATE_FLAGS_DISABLE_ISO);
-        applyUnitState("DisableUnitFiles", names, STATE_FLAGS_DISABLE);
+    for (size_t i = 0; i < units.size(); i++) {
+      if (units[i]->state != NULL && std::string(units[i]->state).find("enabled") == 0) {
+        enabled.push_back(names[i]);
       }
+    }
 
-      if (state != NULL) {
-        free((void *)state);
-      }
+    if (enabled.empty()) {
+      return;
     }
+
+    enabled.push_back(NULL);
+    applyUnitState("DisableUnitFiles", enabled.data(), STATE_FLAGS_DISABLE_ISO);
+    applyUnitState("DisableUnitFiles", enabled.data(), STATE_FLAGS_DISABLE);
   } catch(std::string &err) {
     throw err;
   }
@@ -478,9 +651,7 @@ void ChkBus::applyUnitSub(const char *name, const char *method) {
   sd_bus_message *busMessage = NULL;
   sd_bus_message *reply = NULL;
 
-  if (!isConnected()) {
-    connect();
-  }
+  ensureConnected();
 
   status = sd_bus_call_method(
     bus,
@@ -502,7 +673,6 @@ void ChkBus::applyUnitSub(const char *name, const char *method) {
   finish:
     sd_bus_error_free(&error);
     sd_bus_message_unref(busMessage);
-    disconnect();
 
     if (status < 0) {
       throw std::string(errorMessage);
@@ -516,9 +686,9 @@ void ChkBus::enableUnits(std::set<std::string> *ids) {
     return;
   }
 
-  char *names[ids->size()];
+  char *names[ids->size() + 1];
 
-  for (auto id : (*ids)) {
+  for (auto &id : (*ids)) {
     names[i] = (char *) id.c_str();
     i++;
   }
@@ -538,9 +708,9 @@ void ChkBus::disableUnits(std::set<std::string> *ids) {
     return;
   }
 
-  char *names[ids->size()];
+  char *names[ids->size() + 1];
 
-  for (auto id : (*ids)) {
+  for (auto &id : (*ids)) {
     names[i] = (char *) id.c_str();
     i++;
   }
@@ -549,6 +719,7 @@ void ChkBus::disableUnits(std::set<std::string> *ids) {
 
   try {
     applyUnitState("DisableUnitFiles", names, STATE_FLAGS_DISABLE);
+    checkDisabledStatus(names);
   } catch (std::string &err) {
     throw err;
   }
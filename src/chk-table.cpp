@@ -0,0 +1,124 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chk-ctl.h"
+#include "chk-table.h"
+
+void UnitTable::clear() {
+  items.clear();
+  types.clear();
+}
+
+/*
+ * Appends the item as the last row, the item keeps its row number
+ */
+int UnitTable::add(UnitItem *item) {
+  item->row = items.size();
+
+  items.push_back(item);
+  types.push_back(typeId(item->target.c_str()));
+
+  return item->row;
+}
+
+/*
+ * Removes the row, the last row is moved in its place
+ */
+void UnitTable::remove(int row) {
+  int last = items.size() - 1;
+
+  items[row]->row = -1;
+
+  if (row != last) {
+    items[row] = items[last];
+    items[row]->row = row;
+    types[row] = types[last];
+  }
+
+  items.pop_back();
+  types.pop_back();
+}
+
+void UnitTable::setState(int row, int state) {
+  items[row]->state = state;
+}
+
+void UnitTable::setSub(int row, int sub) {
+  items[row]->sub = sub;
+}
+
+int UnitTable::typeId(const char *type) {
+  for (size_t i = 0; i < typeNames.size(); i++) {
+    if (typeNames[i].compare(type) == 0) {
+      return i;
+    }
+  }
+
+  typeNames.push_back(type);
+
+  return typeNames.size() - 1;
+}
+
+const std::string &UnitTable::typeName(int type) {
+  return typeNames[type];
+}
+
+int UnitTable::typesCount() {
+  return typeNames.size();
+}
+
+int UnitTable::size() {
+  return items.size();
+}
+
+UnitItem *UnitTable::item(int row) {
+  return items[row];
+}
+
+int UnitTable::type(int row) {
+  return types[row];
+}
+
+const std::vector<UnitItem *> &UnitTable::getItems() {
+  return items;
+}
+
+/*
+ * Rows of every type starting with prefix, matched once per type
+ * and then looked up by type id
+ */
+void UnitTable::selectByType(const char *prefix, std::vector<int> *rows) {
+  std::string pattern(prefix == NULL ? "" : prefix);
+  int size = types.size();
+
+  typeMask.assign(typeNames.size(), 0);
+
+  for (size_t i = 0; i < typeNames.size(); i++) {
+    typeMask[i] = typeNames[i].compare(0, pattern.size(), pattern) == 0;
+  }
+
+  rows->clear();
+
+  for (int i = 0; i < size; i++) {
+    if (typeMask[types[i]]) {
+      rows->push_back(i);
+    }
+  }
+}
@@ -23,9 +23,15 @@
 #include "chk-systemd.h"
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
 #include <cstring>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 
 MainWindow::MainWindow() {
   setSize();
@@ -35,7 +41,28 @@ MainWindow::MainWindow() {
 }
 
 MainWindow::~MainWindow() {
-  delwin(win);
+  if (win != NULL) {
+    delwin(win);
+  }
+
+  delete search;
+  delete filter;
+  delete ctl;
+  delete screenSize;
+  delete winSize;
+  delete padding;
+
+  if (timerFd >= 0) {
+    close(timerFd);
+  }
+
+  if (signalFd >= 0) {
+    close(signalFd);
+  }
+}
+
+void MainWindow::setScope(const UnitScope &scope) {
+  ctl->bus->setScope(scope);
 }
 
 void MainWindow::resize() {
@@ -48,6 +75,7 @@ void MainWindow::resize() {
   // Bring up a new one
   setSize();
   createWindow();
+  invalidateFrame();
 
   // This case handles resizing to smaller window
   // We need to make sure that currently selected line
@@ -64,33 +92,158 @@ void MainWindow::resize() {
 
 void MainWindow::createWindow() {
   win = newwin(screenSize->h, screenSize->w, 0, 0);
+  idlok(win, TRUE);
 }
 
+/*
+ * Single event loop: keyboard, systemd bus, bus timeouts, terminal
+ * resizes and worker results are all waited for with one poll() and
+ * handled without blocking each other. Whatever arrived together is drawn once.
+ */
 void MainWindow::createMenu() {
+  struct pollfd fds[LOOP_FDS];
+
   createWindow();
+  createLoop();
+  drawUnits();
 
   while(1) {
-    drawUnits();
-
-    int key = wgetch(stdscr);
-    error(NULL);
-
-    switch(inputFor) {
-      case INPUT_FOR_SEARCH:
-        searchInput(key);
-        break;
-      default:
-        listInput(key);
-        break;
+    bool redraw = false;
+
+    fds[LOOP_FD_INPUT].fd = STDIN_FILENO;
+    fds[LOOP_FD_INPUT].events = POLLIN;
+    fds[LOOP_FD_BUS].fd = ctl->bus->getFd();
+    fds[LOOP_FD_BUS].events = ctl->bus->getEvents();
+    fds[LOOP_FD_TIMER].fd = timerFd;
+    fds[LOOP_FD_TIMER].events = POLLIN;
+    fds[LOOP_FD_SIGNAL].fd = signalFd;
+    fds[LOOP_FD_SIGNAL].events = POLLIN;
+    fds[LOOP_FD_WORKER].fd = ctl->worker->getFd();
+    fds[LOOP_FD_WORKER].events = POLLIN;
+
+    armBusTimer();
+
+    /*
+     * A fetch in progress goes on as soon as nothing else is waiting
+     */
+    if (poll(fds, LOOP_FDS, ctl->isFetching() ? 0 : -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error((char *)"Failed: poll");
+      continue;
+    }
+
+    if (fds[LOOP_FD_SIGNAL].revents & POLLIN) {
+      struct signalfd_siginfo info;
+
+      while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+        continue;
+      }
+
+      resizeTerminal();
+      redraw = true;
+    }
+
+    if (fds[LOOP_FD_TIMER].revents & POLLIN) {
+      uint64_t expirations;
+
+      if (read(timerFd, &expirations, sizeof(expirations)) < 0) {
+        expirations = 0;
+      }
+    }
+
+    if (fds[LOOP_FD_INPUT].revents & POLLIN) {
+      int key;
+
+      while ((key = wgetch(stdscr)) != ERR) {
+        handleKey(key);
+        redraw = true;
+      }
+    }
+
+    if (applyUpdates()) {
+      redraw = true;
+    }
+
+    if (redraw) {
+      drawUnits();
     }
   }
 }
 
+void MainWindow::createLoop() {
+  sigset_t mask;
+
+  nodelay(stdscr, true);
+
+  /*
+   * SIGWINCH is read from signalfd instead of ncurses handler
+   */
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGWINCH);
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+
+  signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+/*
+ * The bus may need processing at a given time even without traffic,
+ * e.g. to time out a call, the timer fires at that time.
+ */
+void MainWindow::armBusTimer() {
+  struct itimerspec spec;
+  uint64_t timeout = ctl->bus->getTimeout();
+
+  memset(&spec, 0, sizeof(spec));
+
+  if (timeout == 0) {
+    spec.it_value.tv_nsec = 1;
+  } else if (timeout != (uint64_t) -1) {
+    spec.it_value.tv_sec = timeout / 1000000;
+    spec.it_value.tv_nsec = (timeout % 1000000) * 1000;
+  }
+
+  timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void MainWindow::resizeTerminal() {
+  struct winsize ws;
+
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+    resizeterm(ws.ws_row, ws.ws_col);
+  }
+
+  resize();
+}
+
+void MainWindow::handleKey(int key) {
+  error(NULL);
+
+  switch(inputFor) {
+    case INPUT_FOR_SEARCH:
+      searchInput(key);
+      break;
+    case INPUT_FOR_FILTER:
+      filterInput(key);
+      break;
+    default:
+      listInput(key);
+      break;
+  }
+}
+
 void MainWindow::listInput(int key) {
   switch(key) {
     case '/':
       inputFor = INPUT_FOR_SEARCH;
       break;
+    case 'F':
+      memset(searchString, 0, BUFSIZ);
+      search->clear();
+      inputFor = INPUT_FOR_FILTER;
+      break;
     case 'k':
     case 'p':
     case KEY_UP:
@@ -119,7 +272,26 @@ void MainWindow::listInput(int key) {
       exit(0);
       break;
     case ' ':
-      toggleUnitState();
+      if (marks.empty()) {
+        toggleUnitState();
+      } else {
+        toggleMarkedUnits();
+      }
+      break;
+    case 'm':
+      markUnit();
+      break;
+    case 'v':
+      markRange();
+      break;
+    case '*':
+      markMatches();
+      break;
+    case 'a':
+      markAll();
+      break;
+    case 'u':
+      clearMarks();
       break;
     case 's':
       toggleUnitSubState();
@@ -133,12 +305,12 @@ void MainWindow::listInput(int key) {
       movePageEnd();
       break;
     case 'g':
-      start = 0;
-      selected = 0;
-      moveUp();
+      movePageStart();
       break;
     case '?':
       aboutWindow(screenSize);
+      touchwin(win);
+      invalidateFrame();
       break;
     case KEY_RESIZE:
       resize();
@@ -154,17 +326,28 @@ void MainWindow::searchInput(int key) {
   switch(key) {
     case 27: // ESC
       memset(searchString, 0, BUFSIZ);
+      search->clear();
       inputFor = INPUT_FOR_LIST;
       break;
     case KEY_ENTER: // Ctrl-M
     case 10: // Enter
       searchNext();
       break;
+    case KEY_DOWN:
+    case CTRL('n'):
+      searchMove(1);
+      break;
+    case KEY_UP:
+    case CTRL('p'):
+      searchMove(-1);
+      break;
     case KEY_BACKSPACE:
       slen = strlen(searchString);
       if (slen > 0) {
         searchString[slen - 1] = 0;
+        searchUpdate();
       } else {
+        search->clear();
         inputFor = INPUT_FOR_LIST;
       }
       break;
@@ -180,8 +363,11 @@ void MainWindow::searchInput(int key) {
       /*
        * Using something that looks like a string for search
        */
-      if (key > 10 && key < 128) {
-        sprintf(searchString, "%s%c", searchString, key);
+      slen = strlen(searchString);
+      if (key > 10 && key < 128 && slen < BUFSIZ - 1) {
+        searchString[slen] = key;
+        searchString[slen + 1] = 0;
+        searchUpdate();
       }
       break;
   }
@@ -189,228 +375,608 @@ void MainWindow::searchInput(int key) {
 
 void MainWindow::drawSearch() {
   /*
-   * Lets indicate it is a search input
+   * Lets indicate it is a search input, cut at the end of the line
    */
-  char text[BUFSIZ] = "/";
+  std::vector<char> text(std::max(winSize->w, 1) + 1);
 
-  if (lastFound == 0) {
-     sprintf(text, "%s%s", text, searchString);
+  if (lastFound == 0 && searchString[0] != 0) {
+    snprintf(text.data(), text.size(), "/%s  (%zu)", searchString, search->count());
+  } else {
+    snprintf(text.data(), text.size(), "/");
   }
 
   /*
    * Draw it using any visible, light color
    */
-  drawStatus(1, text, 0);
+  drawStatus(1, text.data(), 0);
 }
 
 /*
- * Looking for a next match
+ * Narrows matches while typing, the cursor goes to the first match
+ * from its current line on
  */
-void MainWindow::searchNext() {
-  int position = 0;
+void MainWindow::searchUpdate() {
+  int row = start + selected;
 
-  for (auto unit : units) {
-    if (unit->id.size() == 0) {
-      continue;
-    }
+  buildSearch();
+  search->find(searchString);
 
-    if (lastFound < position && unit->id.rfind(searchString) != std::string::npos) {
-      inputFor = INPUT_FOR_LIST;
-      lastFound = position;
-      moveTo(position);
-      return;
-    }
+  if (!search->isMatch(row)) {
+    row = search->next(row);
+  }
+
+  if (row >= 0) {
+    placeCursor(row);
+  }
+}
+
+void MainWindow::searchMove(int direction) {
+  int row = start + selected;
+
+  row = direction < 0 ? search->prev(row) : search->next(row);
 
-    position++;
+  if (row >= 0) {
+    placeCursor(row);
   }
+}
 
-  /*
-   * Nothing found
-   */
+/*
+ * Accepts the match under the cursor, or moves to the next one
+ * when the search is repeated
+ */
+void MainWindow::searchNext() {
   inputFor = INPUT_FOR_LIST;
 
+  if (lastFound == 0) {
+    buildSearch();
+    search->find(searchString);
+  }
+
   /*
    * Nothing at all
    */
-  if (lastFound == 0) {
+  if (search->count() == 0) {
     memset(searchString, 0, BUFSIZ);
+    search->clear();
     return;
   }
 
-  /*
-   * Repeat search
-   */
-  lastFound = 0;
-  searchNext();
+  if (lastFound != 0 || !search->isMatch(start + selected)) {
+    searchMove(1);
+  }
+
+  lastFound = 1;
 }
 
 void MainWindow::setSize() {
   getmaxyx(stdscr, screenSize->h, screenSize->w);
 }
 
-void MainWindow::moveTo(int position) {
-  start = selected = 0;
-
-  for (int i = 0; i < position; i++) {
-      moveDown();
-  }
+int MainWindow::pageSize() {
+  return winSize->h - (padding->y + 1);
 }
 
-void MainWindow::moveUp() {
-  int ps = winSize->h - (padding->y + 1);
+/*
+ * Nearest unit line (not a separator) from row in the given direction,
+ * falls back to the other direction at the ends of the list
+ */
+int MainWindow::unitRow(int row, int direction) {
+  int max = units.size() - 1;
 
-  if (start > 0 && selected < ps / 2) {
-    start--;
-  } else if (selected > 0) {
-    selected--;
-  }
+  row = std::max(0, std::min(row, max));
 
-  if (units[start + selected]->id.size() == 0) {
-    moveUp();
+  int found = direction < 0 ? prevRows[row] : nextRows[row];
+
+  if (found < 0) {
+    found = direction < 0 ? nextRows[row] : prevRows[row];
   }
+
+  return found;
 }
 
-void MainWindow::moveDown() {
-  int offset = start + selected;
-  int ps = winSize->h - (padding->y + 1);
+/*
+ * Shows row. The list stays where it is while row is on the page,
+ * scrolls by as little as needed when row is close to the page and
+ * centres row when it is farther away.
+ */
+void MainWindow::placeCursor(int row) {
+  int ps = pageSize();
   int max = units.size() - 1;
 
-  if ((start + ps) < max) {
-    if (selected < ps / 2) {
-      selected++;
-    } else {
-      start++;
-    }
-  } else if (offset < max) {
-    selected++;
+  if (row < start - ps || row > start + ps * 2) {
+    start = row - ps / 2;
+  } else if (row < start) {
+    start = row;
+  } else if (row > start + ps) {
+    start = row - ps;
   }
 
-  if (offset >= max) {
-    selected = ps;
-  }
+  start = std::max(0, std::min(start, max - ps));
+  selected = row - start;
+}
 
-  if (units[start + selected]->id.size() == 0) {
-    moveDown();
+void MainWindow::moveTo(int position) {
+  if (position < 0 || position >= (int)unitRows.size()) {
+    return;
   }
+
+  placeCursor(unitRows[position]);
 }
 
-void MainWindow::movePageUp() {
-  int ps = winSize->h - (padding->y + 1);
+void MainWindow::moveUp() {
+  int row = start + selected;
 
-  if (start > 0) {
-    start -= ps;
+  if (units.empty() || row == 0 || prevRows[row - 1] < 0) {
+    return;
   }
 
-  if (start < 0) {
-    start = 0;
-    selected = 0;
-  }
+  placeCursor(prevRows[row - 1]);
+}
+
+void MainWindow::moveDown() {
+  int row = start + selected;
+  int max = units.size() - 1;
 
-  if (units[start + selected]->id.size() == 0) {
-    moveUp();
+  if (units.empty() || row >= max || nextRows[row + 1] < 0) {
+    return;
   }
+
+  placeCursor(nextRows[row + 1]);
 }
 
-void MainWindow::movePageDown() {
-  int ps = winSize->h - 3;
+/*
+ * Paging moves the list by a page and keeps the cursor on its line
+ * when possible
+ */
+void MainWindow::movePage(int direction) {
+  int ps = pageSize();
   int max = units.size() - 1;
 
-  if ((start + ps / 2) < max) {
-    start += ps;
+  if (units.empty()) {
+    return;
   }
 
-  if ((start + ps) > max) {
-    start = max - ps;
-    selected = ps;
-  }
+  int row = unitRow(start + selected + direction * ps, direction);
 
-  if (units[start + selected]->id.size() == 0) {
-    moveDown();
+  start = std::max(0, std::min(start + direction * ps, max - ps));
+  selected = row - start;
+
+  if (selected < 0 || selected > ps) {
+    placeCursor(row);
   }
 }
 
+void MainWindow::movePageUp() {
+  movePage(-1);
+}
+
+void MainWindow::movePageDown() {
+  movePage(1);
+}
+
 void MainWindow::movePageEnd() {
-  int ps = winSize->h - 3;
-  int max = units.size() - 1;
+  if (units.empty()) {
+    return;
+  }
 
-  start = max - ps;
-  selected = ps;
+  placeCursor(unitRow(units.size() - 1, -1));
+}
 
-  if (units[start + selected]->id.size() == 0) {
-    moveDown();
+void MainWindow::movePageStart() {
+  if (units.empty()) {
+    return;
   }
+
+  placeCursor(unitRow(0, 1));
 }
 
-void MainWindow::reloadAll() {
+int MainWindow::applyUpdates() {
+  int changed = UNIT_UPDATE_NONE;
+
   try {
-    ctl->bus->reloadDaemon();
-    updateUnits();
+    changed = ctl->update();
+
+    if (ctl->isFetching()) {
+      changed |= ctl->fetchNext();
+    }
   } catch (std::string &err) {
+    /*
+     * Items may have been removed before the error, the list is
+     * taken again so that none of them stays on screen
+     */
     error((char *)err.c_str());
+    changed = UNIT_UPDATE_ROWS | UNIT_UPDATE_LIST;
+  }
+
+  if (changed & UNIT_UPDATE_LIST) {
+    setAllUnits(ctl->getItemsSorted());
+  }
+
+  return changed;
+}
+
+/*
+ * Scrolls the list lines on the screen and the frame with them, only
+ * the lines that come in are left to paint
+ */
+void MainWindow::scrollFrame(int lines) {
+  int rows = frame.size();
+  FrameRow blank = { NULL, 0, 0, false, false, false };
+
+  wsetscrreg(win, padding->y, padding->y + rows - 1);
+  scrollok(win, TRUE);
+  wscrl(win, lines);
+  scrollok(win, FALSE);
+
+  if (lines > 0) {
+    frame.erase(frame.begin(), frame.begin() + lines);
+    frame.insert(frame.end(), lines, blank);
+  } else {
+    frame.erase(frame.end() + lines, frame.end());
+    frame.insert(frame.begin(), -lines, blank);
   }
 }
 
+/*
+ * Forgets what is on the screen, next drawUnits repaints every line
+ */
+void MainWindow::invalidateFrame() {
+  frame.clear();
+}
+
+/*
+ * Starts a new fetch with its first step, so there is something to
+ * draw right away. The rest of the list fills in from applyUpdates().
+ */
 void MainWindow::updateUnits() {
+  allUnits.clear();
   units.clear();
-  units.shrink_to_fit();
+  invalidateFrame();
 
   try {
-    ctl->fetch();
-    units = ctl->getItemsSorted();
+    ctl->fetchStart();
+    ctl->fetchNext();
   } catch(std::string &err) {
     error((char *)err.c_str());
   }
+
+  setAllUnits(ctl->getItemsSorted());
 }
 
-void MainWindow::drawUnits() {
+bool MainWindow::isLoading() {
+  return ctl->isFetching();
+}
+
+/*
+ * A new full list, the filter (if any) is applied to it again
+ */
+void MainWindow::setAllUnits(const std::vector<UnitItem *> &list) {
+  allUnits = list;
+  filterQueries.clear();
+  filterViews.clear();
+  filterDirty = true;
+  groupTitles.clear();
+  groupSeparator = NULL;
+
+  for (auto unit : allUnits) {
+    if (unit->id.size() != 0) {
+      continue;
+    }
+
+    if (unit->target.size() == 0) {
+      groupSeparator = unit;
+    } else {
+      groupTitles[unit->target] = unit;
+    }
+  }
+
+  applyFilter();
+}
+
+/*
+ * Shows list, the selected unit stays on its screen line when it is
+ * still in the list
+ */
+void MainWindow::showUnits(const std::vector<UnitItem *> &list) {
+  UnitItem *current = NULL;
+  int row = start + selected;
+
+  if (row < (int)units.size()) {
+    current = units[row];
+  }
+
+  units = list;
+  indexUnits();
+
   if (units.empty()) {
+    start = selected = 0;
+    return;
+  }
+
+  for (int i = 0; current != NULL && i < (int)units.size(); i++) {
+    if (units[i] == current) {
+      start = i - selected;
+      if (start < 0) {
+        start = 0;
+        selected = i;
+      }
+      return;
+    }
+  }
+
+  row = std::min(row, (int)units.size() - 1);
+
+  if (units[row]->id.size() == 0) {
+    placeCursor(unitRow(row, 1));
+  } else if (row < start) {
+    placeCursor(row);
+  }
+}
+
+/*
+ * Filter view of the full list. Every query keeps its view, a longer
+ * query narrows the previous matches and backspace returns to the view
+ * of the shorter query. Views are kept by their query, a new full list
+ * drops them all.
+ */
+void MainWindow::applyFilter() {
+  if (filterString[0] == 0) {
+    showUnits(allUnits);
+    return;
+  }
+
+  if (filterDirty) {
+    filter->build(allUnits);
+    filterDirty = false;
+  }
+
+  std::string query(filterString);
+
+  while (!filterQueries.empty() &&
+      query.compare(0, filterQueries.back().size(), filterQueries.back()) != 0) {
+    filterQueries.pop_back();
+    filterViews.pop_back();
+  }
+
+  if (filterQueries.empty() || filterQueries.back() != query) {
+    const std::vector<int> &found = filter->find(filterString);
+    std::vector<UnitItem *> view;
+    UnitString *target = NULL;
+
+    view.reserve(found.size());
+
+    /*
+     * Same grouping as the full list: a title between unit types,
+     * none before the first one
+     */
+    for (int row : found) {
+      UnitItem *unit = allUnits[row];
+
+      if (target != NULL && unit->target != *target) {
+        auto title = groupTitles.find(unit->target);
+
+        if (title != groupTitles.end() && groupSeparator != NULL) {
+          view.push_back(groupSeparator);
+          view.push_back(title->second);
+          view.push_back(groupSeparator);
+        }
+      }
+
+      target = &unit->target;
+      view.push_back(unit);
+    }
+
+    filterQueries.push_back(query);
+    filterViews.push_back(view);
+  }
+
+  showUnits(filterViews.back());
+}
+
+void MainWindow::filterInput(int key) {
+  int slen = strlen(filterString);
+
+  switch(key) {
+    case 27: // ESC
+      memset(filterString, 0, BUFSIZ);
+      filter->clear();
+      filterQueries.clear();
+      filterViews.clear();
+      inputFor = INPUT_FOR_LIST;
+      applyFilter();
+      break;
+    case KEY_ENTER: // Ctrl-M
+    case 10: // Enter
+      inputFor = INPUT_FOR_LIST;
+      break;
+    case KEY_BACKSPACE:
+      if (slen > 0) {
+        filterString[slen - 1] = 0;
+        applyFilter();
+      } else {
+        inputFor = INPUT_FOR_LIST;
+      }
+      break;
+    default:
+      if (key > 10 && key < 128 && slen < BUFSIZ - 1) {
+        filterString[slen] = key;
+        filterString[slen + 1] = 0;
+        applyFilter();
+      }
+      break;
+  }
+}
+
+/*
+ * Text longer than the status line is cut at its end
+ */
+void MainWindow::drawFilter() {
+  std::vector<char> text(std::max(winSize->w, 0) + 1);
+
+  snprintf(text.data(), text.size(), "filter: %s  (%d)", filterString, totalUnits());
+
+  drawStatus(1, text.data(), 0);
+}
+
+void MainWindow::drawUnits() {
+  if (allUnits.empty() && !ctl->isFetching() && !fetched) {
+    fetched = true;
     updateUnits();
   }
 
   getmaxyx(win, winSize->h, winSize->w);
   winSize->h -= padding->y;
 
-  for (int i = 0; i < (winSize->h - padding->y); i++) {
-    if ((i + start) > (int)units.size() - 1) {
-      break;
+  int rows = winSize->h - padding->y;
+
+  if (rows < 0) {
+    rows = 0;
+  }
+
+  if ((int)frame.size() != rows) {
+    frame.assign(rows, FrameRow { NULL, 0, 0, false, false, false });
+  } else if (start != frameStart && std::abs(start - frameStart) < rows) {
+    scrollFrame(start - frameStart);
+  }
+
+  frameStart = start;
+
+  /*
+   * Rows on screen and one page below them get their details,
+   * scrolling down then finds them already loaded
+   */
+  try {
+    ctl->loadDetails(units, start, rows * 2);
+  } catch (std::string &err) {
+    error((char *)err.c_str());
+  }
+
+  /*
+   * Only lines that differ from what was drawn last time are repainted,
+   * or have to be formatted again
+   */
+  for (int i = 0; i < rows; i++) {
+    FrameRow row = { NULL, 0, 0, i == selected, search->isMatch(start + i), false };
+
+    if ((i + start) < (int)units.size()) {
+      row.unit = units[start + i];
+      row.state = row.unit->state;
+      row.sub = row.unit->sub;
+      row.marked = isMarked(row.unit);
     }
 
-    UnitItem *unit = units[start + i];
+    FrameRow &drawn = frame[i];
+
+    if (drawn.unit == row.unit && drawn.state == row.state &&
+        drawn.sub == row.sub && drawn.selected == row.selected &&
+        drawn.match == row.match && drawn.marked == row.marked &&
+        (row.unit == NULL || row.unit->lineWidth == winSize->w)) {
+      continue;
+    }
+
+    drawn = row;
+
+    if (row.unit == NULL) {
+      wmove(win, i + padding->y, 0);
+      wclrtoeol(win);
+      continue;
+    }
 
-    if (i == selected) {
+    if (row.selected) {
       wattron(win, A_REVERSE);
     }
 
-    drawItem(unit, i + padding->y);
+    drawItem(row.unit, i + padding->y, row.match, row.marked);
     wattroff(win, A_REVERSE);
   }
 
-  if (inputFor == INPUT_FOR_LIST) {
-    drawInfo();
-  } else {
+  if (inputFor == INPUT_FOR_SEARCH) {
     drawSearch();
+  } else if (inputFor == INPUT_FOR_FILTER) {
+    drawFilter();
+  } else {
+    drawInfo();
   }
 
-  refresh();
-  wrefresh(win);
+  /*
+   * One update for both windows, the frame goes out in a single write
+   */
+  wnoutrefresh(stdscr);
+  wnoutrefresh(win);
+  doupdate();
 }
 
-void MainWindow::drawItem(UnitItem *unit, int y) {
+/*
+ * Builds the text part of a line once for the current width,
+ * drawing then only copies it to the window.
+ */
+void MainWindow::formatItem(UnitItem *unit) {
+  int width = winSize->w;
+
+  unit->lineWidth = width;
+
   if (unit->id.size() == 0) {
-    if (unit->target.size() == 0) {
-      printInMiddle(win, y, 0, winSize->w, (char *)"", COLOR_PAIR(3), (char *)' ');
-    } else {
+    unit->line.assign(width < 0 ? 0 : width, ' ');
+    unit->lineSplit = 0;
+
+    if (unit->target.size() != 0) {
       std::string title(unit->target);
       title += "s";
       title[0] = std::toupper(title[0]);
 
-      printInMiddle(win, y, 0, winSize->w, (char *)"", COLOR_PAIR(3), (char *)' ');
-      printInMiddle(win, y, 0, winSize->w / 2, (char *)title.c_str(),
-          COLOR_PAIR(3), (char *)' ');
+      int x = (width / 2 - (int)title.size()) / 2;
+
+      if (x >= 0) {
+        unit->line.replace(x, title.size(), title);
+      }
     }
     return;
   }
 
+  int leftPad = padding->x + 8;
+  int rightPad = width - leftPad;
+  int length = rightPad - padding->x;
+  int descWidth = width / 2;
+
+  if (length < 0) {
+    length = 0;
+  }
+
+  unit->line.assign(length, ' ');
+
+  int idLength = std::min((int)unit->id.size(), length);
+  unit->line.replace(0, idLength, unit->id.data(), idLength);
+
+  /*
+   * Description column is right aligned, it moves aside for long names
+   */
+  int descStart = std::max(idLength + 1, rightPad + 1 - descWidth);
+  int descLength = std::min((int)unit->description.size(),
+      std::min(descWidth, length - descStart));
+
+  if (descLength > 0) {
+    unit->line.replace(descStart, descLength, unit->description.data(), descLength);
+  }
+
+  unit->lineSplit = std::min(descStart, length);
+}
+
+void MainWindow::drawItem(UnitItem *unit, int y, bool match, bool marked) {
+  if (unit->lineWidth != winSize->w) {
+    formatItem(unit);
+  }
+
+  if (unit->id.size() == 0) {
+    wattron(win, COLOR_PAIR(3));
+    mvwaddnstr(win, y, 0, unit->line.data(), unit->line.size());
+    wattroff(win, COLOR_PAIR(3));
+    return;
+  }
+
+  wattron(win, COLOR_PAIR(2) | A_BOLD);
+  mvwaddstr(win, y, 0, marked ? "* " : "  ");
+  wattroff(win, COLOR_PAIR(2) | A_BOLD);
+
   if (unit->state == UNIT_STATE_ENABLED) {
     wattron(win, COLOR_PAIR(2));
     mvwprintw(win, y, padding->x, "[x]");
@@ -431,6 +997,10 @@ void MainWindow::drawItem(UnitItem *unit, int y) {
     wattron(win, COLOR_PAIR(3));
     mvwprintw(win, y, padding->x, "-m-");
     wattroff(win, COLOR_PAIR(3));
+  } else if (unit->state == UNIT_STATE_TMP) {
+    wattron(win, COLOR_PAIR(5));
+    mvwprintw(win, y, padding->x, "[~]");
+    wattroff(win, COLOR_PAIR(5));
   }
 
   if (unit->sub == UNIT_SUBSTATE_RUNNING) {
@@ -441,39 +1011,28 @@ void MainWindow::drawItem(UnitItem *unit, int y) {
     wattron(win, COLOR_PAIR(5));
     mvwprintw(win, y, padding->x + 3, "  =  ");
     wattroff(win, COLOR_PAIR(5));
+  } else if (unit->sub == UNIT_SUBSTATE_TMP) {
+    wattron(win, COLOR_PAIR(5));
+    mvwprintw(win, y, padding->x + 3, "  ~  ");
+    wattroff(win, COLOR_PAIR(5));
   } else {
     wattron(win, COLOR_PAIR(5));
     mvwprintw(win, y, padding->x + 3, "     ");
     wattroff(win, COLOR_PAIR(5));
   }
 
-  unsigned int leftPad = padding->x + 8;
-  unsigned int rightPad = (winSize->w - leftPad);
+  int leftPad = padding->x + 8;
 
-  if (unit->id.size() > (rightPad - padding->x)) {
-    unit->id.resize(rightPad - padding->x);
-  }
-
-  std::stringstream sline;
-
-  unit->description.resize(winSize->w / 2, ' ');
-  sline << std::string(unit->id.size(), ' ') << " "
-    << std::setw(rightPad - unit->id.size())
-    << unit->description;
-
-  std::string cline(sline.str());
-  std::string name(unit->id);
-
-  name.resize(cline.find_first_of(unit->description[0]), ' ');
-
-  if (cline.size() > rightPad) {
-    cline.resize(rightPad - 2 );
+  if (match) {
+    wattron(win, COLOR_PAIR(2) | A_BOLD);
   }
 
+  mvwaddnstr(win, y, leftPad, unit->line.data(), unit->lineSplit);
+  wattroff(win, COLOR_PAIR(2) | A_BOLD);
   wattron(win, COLOR_PAIR(4));
-  mvwprintw(win, y, leftPad, "%s", cline.c_str());
+  waddnstr(win, unit->line.data() + unit->lineSplit,
+      unit->line.size() - unit->lineSplit);
   wattroff(win, COLOR_PAIR(4));
-  mvwprintw(win, y, leftPad, "%s", name.c_str());
 }
 
 /*
@@ -484,77 +1043,248 @@ void MainWindow::drawItem(UnitItem *unit, int y) {
  * - color it with any color we like
  */
 void MainWindow::drawStatus(int position, const char *text, int color) {
-  char emptyStr[winSize->w + 1];
-  memset(&emptyStr, 0x20, winSize->w);
-
   /*
    * Clear it first
    */
-  mvwprintw(win, winSize->h + 1, 0, emptyStr);
+  wmove(win, winSize->h + 1, 0);
+  wclrtoeol(win);
 
   /*
-   * Then draw
+   * Then draw, text may come from the user and is no format
    */
   wattron(win, COLOR_PAIR(color));
-  mvwprintw(win, winSize->h + 1, position, text);
+  mvwprintw(win, winSize->h + 1, position, "%s", text);
   wattroff(win, COLOR_PAIR(color));
 }
 
 void MainWindow::drawInfo() {
-  std::stringstream position;
-  int count = 0;
-  int countUntilNow = start + selected;
+  char position[64];
+  int row = start + selected;
+  int countUntilNow = row < (int)ordinals.size() ? ordinals[row] : 0;
+  int length;
 
-  for (auto unit : units) {
-    if (unit->id.size() == 0) {
-      if (countUntilNow > count) {
-        countUntilNow--;
-      }
-      continue;
-    }
+  length = snprintf(position, sizeof(position), "%d/%d", countUntilNow + 1, totalUnits());
 
-    count++;
+  if (!marks.empty() && length > 0 && length < (int)sizeof(position)) {
+    snprintf(position + length, sizeof(position) - length, "  %d marked", (int)marks.size());
   }
 
-  position << countUntilNow + 1 << "/" << count;
-
-  drawStatus((winSize->w / 2), (const char *)position.str().c_str(), 5);
+  drawStatus((winSize->w / 2), position, 5);
 }
 
 int MainWindow::totalUnits() {
+  return unitsCount;
+}
+
+UnitItem *MainWindow::getCursorUnit() {
+  int row = start + selected;
+
+  if (row < 0 || row >= (int)units.size() || units[row]->id.empty()) {
+    return NULL;
+  }
+
+  return units[row];
+}
+
+int MainWindow::getCursorPosition() {
+  return getCursorUnit() == NULL ? 0 : ordinals[start + selected] + 1;
+}
+
+/*
+ * Indexes the list once per change: real units (not separators) before
+ * every line for the position indicator, the line of every unit and the
+ * nearest unit line around every line for navigation.
+ */
+void MainWindow::indexUnits() {
   int count = 0;
+  int size = units.size();
 
-  for (auto unit : units) {
-    if (unit->id.size() == 0) {
-      continue;
+  ordinals.resize(size);
+  nextRows.resize(size);
+  prevRows.resize(size);
+  unitRows.clear();
+
+  for (int i = 0; i < size; i++) {
+    ordinals[i] = count;
+
+    if (units[i]->id.size() != 0) {
+      unitRows.push_back(i);
+      count++;
     }
-    count++;
+
+    prevRows[i] = count > 0 ? unitRows[count - 1] : -1;
+  }
+
+  for (int i = size - 1, next = -1; i >= 0; i--) {
+    if (units[i]->id.size() != 0) {
+      next = i;
+    }
+    nextRows[i] = next;
+  }
+
+  unitsCount = count;
+
+  /*
+   * The search index is built on first use after a list change,
+   * a running search is matched again once the fetch is complete
+   */
+  search->clear();
+  searchDirty = true;
+
+  if (searchString[0] != 0 && !ctl->isFetching()) {
+    buildSearch();
+    search->find(searchString);
   }
+}
 
-  return count;
+void MainWindow::buildSearch() {
+  if (searchDirty) {
+    search->build(units);
+    searchDirty = false;
+  }
 }
 
 void MainWindow::error(char *err) {
-  mvwprintw(win, 0, 0, std::string(winSize->w, ' ').c_str());
+  wmove(win, 0, 0);
+  wclrtoeol(win);
 
   if (err) {
-    mvwprintw(win, 0, 1, err);
+    mvwprintw(win, 0, 1, "%s", err);
   }
 }
 
 void MainWindow::toggleUnitState() {
+  UnitItem *unit = getCursorUnit();
+
+  if (unit == NULL) {
+    return;
+  }
+
+  try {
+    ctl->toggleUnitState(unit);
+  } catch (std::string &err) {
+    error((char *)err.c_str());
+  }
+}
+
+/*
+ * Enables and disables every marked unit with one call per operation,
+ * the marks are done with then
+ */
+void MainWindow::toggleMarkedUnits() {
+  std::vector<UnitItem *> items;
+
+  for (auto &id : marks) {
+    UnitItem *item = ctl->findItem(id.c_str());
+
+    if (item != NULL) {
+      items.push_back(item);
+    }
+  }
+
+  clearMarks();
+
   try {
-    ctl->toggleUnitState(units[start + selected]);
-    reloadAll();
+    ctl->toggleUnitStates(items);
   } catch (std::string &err) {
     error((char *)err.c_str());
   }
 }
 
+bool MainWindow::isMarked(UnitItem *unit) {
+  if (marks.empty() || unit->id.empty()) {
+    return false;
+  }
+
+  return marks.count(unit->id) > 0;
+}
+
+void MainWindow::markUnit() {
+  int row = start + selected;
+
+  if (row >= (int)units.size() || units[row]->id.empty()) {
+    return;
+  }
+
+  std::string id(units[row]->id);
+
+  if (marks.erase(id) == 0) {
+    marks.insert(id);
+  }
+}
+
+/*
+ * First press remembers the unit under the cursor, the second marks
+ * every unit between it and the cursor
+ */
+void MainWindow::markRange() {
+  int row = start + selected;
+  int from = -1;
+
+  if (row >= (int)units.size() || units[row]->id.empty()) {
+    return;
+  }
+
+  if (markFrom.empty()) {
+    markFrom = units[row]->id;
+    error((char *)"Range mark started..");
+    return;
+  }
+
+  for (int i = 0; i < (int)units.size(); i++) {
+    if (units[i]->id == markFrom.c_str()) {
+      from = i;
+      break;
+    }
+  }
+
+  markFrom.clear();
+  error(NULL);
+
+  if (from < 0) {
+    return;
+  }
+
+  for (int i = std::min(from, row); i <= std::max(from, row); i++) {
+    if (!units[i]->id.empty()) {
+      marks.insert(units[i]->id);
+    }
+  }
+}
+
+void MainWindow::markMatches() {
+  for (int i = 0; i < (int)units.size(); i++) {
+    if (search->isMatch(i) && !units[i]->id.empty()) {
+      marks.insert(units[i]->id);
+    }
+  }
+}
+
+/*
+ * Units shown, the filter view or a --state scope narrow them
+ */
+void MainWindow::markAll() {
+  for (auto unit : units) {
+    if (!unit->id.empty()) {
+      marks.insert(unit->id);
+    }
+  }
+}
+
+void MainWindow::clearMarks() {
+  marks.clear();
+  markFrom.clear();
+}
+
 void MainWindow::toggleUnitSubState() {
+  UnitItem *unit = getCursorUnit();
+
+  if (unit == NULL) {
+    return;
+  }
+
   try {
-    ctl->toggleUnitSubState(units[start + selected]);
-    reloadAll();
+    ctl->toggleUnitSubState(unit);
   } catch (std::string &err) {
     error((char *)err.c_str());
   }
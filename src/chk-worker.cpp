@@ -0,0 +1,233 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "chk-worker.h"
+
+ChkWorker::ChkWorker() {
+  bus = new ChkBus();
+  jobsFd = eventfd(0, EFD_CLOEXEC);
+  resultsFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+/*
+ * Jobs not started yet are dropped, the call in flight is waited for.
+ * That is one StartUnit or StopUnit at most, systemd answers those once
+ * the job is queued, or the bus times the call out.
+ */
+ChkWorker::~ChkWorker() {
+  if (running) {
+    running = false;
+    notify(jobsFd);
+    thread.join();
+  }
+
+  close(jobsFd);
+  close(resultsFd);
+  delete bus;
+}
+
+/*
+ * UI thread side. The thread is started with the first job.
+ */
+bool ChkWorker::post(int op, const char *id) {
+  return post(op, std::vector<std::string> { id });
+}
+
+bool ChkWorker::post(int op, const std::vector<std::string> &ids) {
+  WorkerJob job;
+
+  job.op = op;
+  job.ids = ids;
+
+  if (!jobs.push(job)) {
+    return false;
+  }
+
+  if (!running) {
+    running = true;
+    thread = std::thread(&ChkWorker::run, this);
+  }
+
+  notify(jobsFd);
+
+  return true;
+}
+
+/*
+ * UI thread side. Jobs that can be posted for sure, the ones of a
+ * single action are posted all or none
+ */
+size_t ChkWorker::space() {
+  return jobs.space();
+}
+
+/*
+ * UI thread side. The descriptor is reset before the queue is drained,
+ * results queued after that will make it readable again.
+ */
+bool ChkWorker::takeResult(WorkerResult *result) {
+  uint64_t count;
+
+  if (read(resultsFd, &count, sizeof(count)) < 0) {
+    count = 0;
+  }
+
+  return results.pop(result);
+}
+
+int ChkWorker::getFd() {
+  return resultsFd;
+}
+
+void ChkWorker::run() {
+  uint64_t count;
+  WorkerJob job;
+
+  while (running) {
+    if (read(jobsFd, &count, sizeof(count)) < 0) {
+      continue;
+    }
+
+    while (running && jobs.pop(&job)) {
+      execute(&job);
+    }
+  }
+}
+
+/*
+ * An enable or disable is followed by a daemon reload, as systemctl
+ * does, and its unit file states are read back right after, once for
+ * the whole job
+ */
+void ChkWorker::execute(WorkerJob *job) {
+  std::set<std::string> ids(job->ids.begin(), job->ids.end());
+  std::string error;
+
+  try {
+    switch (job->op) {
+      case WORKER_OP_START:
+      case WORKER_OP_STOP:
+        /*
+         * One call per unit, the destructor does not wait for the rest
+         */
+        for (auto &id : ids) {
+          if (!running) {
+            break;
+          }
+
+          if (job->op == WORKER_OP_START) {
+            bus->startUnit(id.c_str());
+          } else {
+            bus->stopUnit(id.c_str());
+          }
+        }
+        break;
+      case WORKER_OP_ENABLE:
+        bus->enableUnits(&ids);
+        break;
+      case WORKER_OP_DISABLE:
+        bus->disableUnits(&ids);
+        break;
+      default:
+        break;
+    }
+  } catch (std::string &err) {
+    error = err;
+  }
+
+  if (job->op != WORKER_OP_ENABLE && job->op != WORKER_OP_DISABLE) {
+    postResults(job, error.empty() ? WORKER_STATUS_DONE : WORKER_STATUS_FAILED,
+        error.empty() ? NULL : error.c_str());
+    return;
+  }
+
+  UnitArena arena;
+  std::vector<UnitInfo *> units;
+
+  for (auto &id : job->ids) {
+    UnitInfo *unit = busNewUnit(&arena);
+
+    unit->id = arena.copy(id.c_str());
+    units.push_back(unit);
+  }
+
+  try {
+    bus->reloadDaemon();
+    bus->getStates(&units, &arena);
+  } catch (std::string &err) {
+    if (error.empty()) {
+      error = err;
+    }
+  }
+
+  for (auto unit : units) {
+    postResult(job->op, unit->id, error.empty() ? WORKER_STATUS_DONE : WORKER_STATUS_FAILED,
+        error.empty() ? NULL : error.c_str(), unit->state);
+  }
+}
+
+void ChkWorker::postResults(WorkerJob *job, int status, const char *error) {
+  for (auto &id : job->ids) {
+    postResult(job->op, id, status, error, NULL);
+  }
+}
+
+void ChkWorker::postResult(int op, const std::string &id, int status, const char *error,
+    const char *state) {
+  WorkerResult result;
+
+  result.op = op;
+  result.status = status;
+  result.id = id;
+  result.error = error == NULL ? "" : error;
+  result.state = state == NULL ? "" : state;
+
+  /*
+   * The UI drains results on every loop pass, a full queue only
+   * has to wait for the next one
+   */
+  while (!results.push(result)) {
+    if (!running) {
+      return;
+    }
+    usleep(1000);
+  }
+
+  notify(resultsFd);
+}
+
+/*
+ * Adds one to an eventfd counter. EAGAIN means the counter is full,
+ * the descriptor is readable then and the reader wakes up anyway.
+ */
+bool notify(int fd) {
+  uint64_t one = 1;
+  ssize_t written;
+
+  do {
+    written = write(fd, &one, sizeof(one));
+  } while (written < 0 && errno == EINTR);
+
+  return written == sizeof(one) || (written < 0 && errno == EAGAIN);
+}
@@ -23,6 +23,13 @@
 
 void startCurses() {
   initscr();
+  setupCurses();
+}
+
+/*
+ * Modes and colors of the current screen
+ */
+void setupCurses() {
   start_color();
   noecho();
   cbreak();
@@ -73,7 +80,7 @@ void printInMiddle(WINDOW *win, int starty, int startx, int width,
 }
 
 void aboutWindow(RECTANGLE *parent) {
-  const int winH = 22;
+  const int winH = 24;
   const int winW = 60;
 
   WINDOW *aboutwin = newwin(winH, winW,
@@ -86,7 +93,14 @@ void aboutWindow(RECTANGLE *parent) {
   wattroff(aboutwin, COLOR_PAIR(2));
   refresh();
   wrefresh(aboutwin);
+
+  /*
+   * Input is read without delay by the main loop, wait for a real key
+   */
+  nodelay(stdscr, false);
   getch();
+  nodelay(stdscr, true);
+
   delwin(aboutwin);
   clear();
   refresh();
@@ -19,6 +19,7 @@
  */
 
 #include <iostream>
+#include <getopt.h>
 
 #include "chk-systemd.h"
 #include "chk-ctl.h"
@@ -27,15 +28,65 @@
 
 using namespace std;
 
+static void splitList(const char *value, vector<string> *list) {
+  string item;
+
+  for (const char *c = value; ; c++) {
+    if (*c == ',' || *c == 0) {
+      if (!item.empty()) {
+        list->push_back(item);
+      }
+      item.clear();
+    } else {
+      item += *c;
+    }
+
+    if (*c == 0) {
+      break;
+    }
+  }
+}
+
 int main(int ac, char **av) {
-  if (ac > 1) {
+  static struct option options[] = {
+    { "type", required_argument, NULL, 't' },
+    { "state", required_argument, NULL, 's' },
+    { "pattern", required_argument, NULL, 'p' },
+    { NULL, 0, NULL, 0 }
+  };
+  UnitScope scope;
+  int option;
+
+  opterr = 0;
+
+  while ((option = getopt_long(ac, av, "", options, NULL)) != -1) {
+    switch (option) {
+      case 't':
+        splitList(optarg, &scope.types);
+        break;
+      case 's':
+        splitList(optarg, &scope.states);
+        break;
+      case 'p':
+        splitList(optarg, &scope.patterns);
+        break;
+      default:
+        fprintf(stdout, ABOUT_INFO, VERSION);
+        fprintf(stdout, USAGE_INFO);
+        return 0;
+    }
+  }
+
+  if (optind < ac) {
     fprintf(stdout, ABOUT_INFO, VERSION);
+    fprintf(stdout, USAGE_INFO);
     return 0;
   }
 
   startCurses();
 
   MainWindow *mainWindow = new MainWindow();
+  mainWindow->setScope(scope);
   mainWindow->createMenu();
 
   delete mainWindow;
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <catch.hpp>
+
+#include "chk-arena.h"
+
+using namespace std;
+
+TEST_CASE("should copy and intern strings", "[UnitArena]") {
+  UnitArena arena;
+  char id[] = "ssh.service";
+
+  const char *copy = arena.copy(id);
+  id[0] = 'x';
+
+  REQUIRE(string(copy) == "ssh.service");
+  REQUIRE(arena.copy(NULL) == NULL);
+  REQUIRE(arena.intern("enabled") == arena.intern("enabled"));
+  REQUIRE(arena.intern("enabled") != arena.intern("disabled"));
+}
+
+TEST_CASE("should keep its size over repeated snapshots", "[UnitArena]") {
+  UnitArena arena;
+  char id[64];
+  size_t capacity = 0;
+
+  for (int fetch = 0; fetch < 10; fetch++) {
+    arena.reset();
+
+    for (int i = 0; i < 100000; i++) {
+      snprintf(id, sizeof(id), "unit-%d.service", i);
+      arena.copy(id);
+      arena.intern("service");
+    }
+
+    if (fetch == 1) {
+      capacity = arena.capacity();
+    }
+  }
+
+  REQUIRE(capacity > ARENA_BLOCK_SIZE);
+  REQUIRE(arena.capacity() == capacity);
+}
+
+TEST_CASE("should view strings without copying", "[UnitString]") {
+  const char *id = "cron.service";
+  UnitString view(id);
+
+  REQUIRE(view.c_str() == id);
+  REQUIRE(view.size() == 12);
+  REQUIRE(view.startsWith("cron") == true);
+  REQUIRE(view.startsWith("service") == false);
+  REQUIRE(view.startsWith("cron.service.d") == false);
+  REQUIRE(view.compare("cron.service") == 0);
+  REQUIRE(view == UnitString("cron.service"));
+  REQUIRE(UnitString(NULL).empty());
+  REQUIRE(string(view) == id);
+}
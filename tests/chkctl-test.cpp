@@ -1,9 +1,69 @@
 #include <iostream>
+#include <cstdio>
+#include <unistd.h>
 #include <catch.hpp>
 #include "chk-ctl.h"
+#include "fake-systemd.h"
 
 using namespace std;
 
+/*
+ * Serves a fixed set of synthetic units without talking to systemd
+ */
+class FakeBus : public ChkBus {
+  public:
+    FakeBus(int size) : size(size) {}
+
+    void subscribe() {}
+
+    void requestUnits(UnitArena *arena) {}
+
+    vector<UnitInfo *> listUnits(UnitArena *arena) {
+      return vector<UnitInfo *>();
+    }
+
+    vector<UnitInfo *> getUnitFiles(UnitArena *arena) {
+      static const char *types[] = { "service", "socket", "timer", "mount", "device" };
+      vector<UnitInfo *> units;
+      char id[64];
+
+      for (int i = 0; i < size; i++) {
+        UnitInfo *unit = busNewUnit(arena);
+
+        snprintf(id, sizeof(id), "unit-%d.%s", i, types[i % 5]);
+        unit->id = busCopy(arena, id);
+        unit->unitPath = busCopy(arena, id);
+        unit->description = busCopy(arena, "Synthetic unit");
+        unit->state = busIntern(arena, i % 2 ? "enabled" : "disabled");
+        unit->subState = busIntern(arena, i % 3 ? "running" : "dead");
+        units.push_back(unit);
+      }
+
+      return units;
+    }
+
+  private:
+    int size;
+};
+
+static long residentKb() {
+  long size = 0;
+  long resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+
+  if (statm == NULL) {
+    return 0;
+  }
+
+  if (fscanf(statm, "%ld %ld", &size, &resident) != 2) {
+    resident = 0;
+  }
+
+  fclose(statm);
+
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
 TEST_CASE("should create object ctl", "[ChkCTL]") {
   ChkCTL *ctl = new ChkCTL();
   REQUIRE(ctl != NULL);
@@ -11,6 +71,9 @@ TEST_CASE("should create object ctl", "[ChkCTL]") {
 }
 
 TEST_CASE("should return sorted items", "[ChkCTL]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkCTL *ctl = new ChkCTL();
 
   REQUIRE_NOTHROW(ctl->fetch());
@@ -25,6 +88,9 @@ TEST_CASE("should return sorted items", "[ChkCTL]") {
 }
 
 TEST_CASE("should get system units against saved items ", "[ChkCTL]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkCTL *ctl = new ChkCTL();
   ctl->fetch();
 
@@ -36,18 +102,21 @@ TEST_CASE("should get system units against saved items ", "[ChkCTL]") {
 }
 
 TEST_CASE("should fetch units and prepare", "[ChkCTL]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkCTL *ctl = new ChkCTL();
   ctl->fetch();
   bool filtered = true;
 
   for (auto unit : ctl->getByTarget("service")) {
-    if (unit->target.find("service") != 0) {
+    if (!unit->target.startsWith("service")) {
       filtered = false;
     }
   }
 
   for (auto unit : ctl->getByTarget("device")) {
-    if (unit->target.find("device") != 0) {
+    if (!unit->target.startsWith("device")) {
       filtered = false;
     }
   }
@@ -58,6 +127,9 @@ TEST_CASE("should fetch units and prepare", "[ChkCTL]") {
 }
 
 TEST_CASE("should fetch items sorted by target", "[ChkCTL]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkCTL *ctl = new ChkCTL();
   ctl->fetch();
 
@@ -82,3 +154,24 @@ TEST_CASE("should fetch items sorted by target", "[ChkCTL]") {
 
   delete ctl;
 }
+
+TEST_CASE("should keep memory flat across refreshes", "[ChkCTL]") {
+  ChkCTL *ctl = new ChkCTL(new FakeBus(500));
+
+  for (int i = 0; i < 100; i++) {
+    ctl->fetch();
+    ctl->getItemsSorted();
+  }
+
+  long warm = residentKb();
+
+  for (int i = 0; i < 2000; i++) {
+    ctl->fetch();
+    ctl->getItemsSorted();
+  }
+
+  REQUIRE(ctl->getItemsSorted().size() == 500 + 4 * 3);
+  REQUIRE(residentKb() - warm < 1024);
+
+  delete ctl;
+}
@@ -0,0 +1,38 @@
+#include <iostream>
+#include <catch.hpp>
+
+#include "chk-details.h"
+
+using namespace std;
+
+TEST_CASE("should keep recently used unit details", "[DetailsCache]") {
+  DetailsCache cache(2);
+
+  cache.put("a.service", "A");
+  cache.put("b.service", "B");
+
+  REQUIRE(cache.find("a.service") != NULL);
+  REQUIRE(*cache.find("a.service") == "A");
+
+  cache.put("c.service", "C");
+
+  REQUIRE(cache.size() == 2);
+  REQUIRE(cache.find("b.service") == NULL);
+  REQUIRE(*cache.find("a.service") == "A");
+  REQUIRE(*cache.find("c.service") == "C");
+
+  cache.put("c.service", "Changed");
+
+  REQUIRE(cache.size() == 2);
+  REQUIRE(*cache.find("c.service") == "Changed");
+
+  REQUIRE(cache.erase("a.service") == true);
+  REQUIRE(cache.erase("a.service") == false);
+  REQUIRE(cache.find("a.service") == NULL);
+  REQUIRE(cache.size() == 1);
+
+  cache.clear();
+
+  REQUIRE(cache.size() == 0);
+  REQUIRE(cache.find("c.service") == NULL);
+}
@@ -0,0 +1,619 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <catch.hpp>
+
+#include "chk-ctl.h"
+#include "fake-systemd.h"
+
+using namespace std;
+
+/*
+ * Runs update() until done returns true or a few seconds passed
+ */
+template <typename Done>
+static bool waitFor(ChkCTL *ctl, Done done) {
+  auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+
+  while (chrono::steady_clock::now() < deadline) {
+    ctl->update();
+
+    if (done()) {
+      return true;
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+
+  return false;
+}
+
+TEST_CASE("should fetch units from fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
+  ChkBus *bus = new ChkBus();
+  vector<UnitInfo *> files;
+  vector<UnitInfo *> units;
+
+  REQUIRE_NOTHROW((files = bus->getUnitFiles()));
+  REQUIRE_NOTHROW((units = bus->getUnits()));
+  REQUIRE((int)files.size() == fake.filesCount());
+  REQUIRE((int)units.size() == fake.loadedCount());
+
+  for (auto unit : files) {
+    ChkBus::freeUnitInfo(unit);
+    delete unit;
+  }
+
+  for (auto unit : units) {
+    ChkBus::freeUnitInfo(unit);
+    delete unit;
+  }
+
+  delete bus;
+
+  ChkCTL *ctl = new ChkCTL();
+  unsigned long stateCalls = fake.getCalls("GetUnitFileState");
+
+  REQUIRE_NOTHROW(ctl->fetch());
+  REQUIRE((int)ctl->getItems().size() == fake.unitsCount());
+
+  UnitItem *ssh = ctl->findItem(FAKE_SSH_UNIT);
+
+  REQUIRE(ssh != NULL);
+  REQUIRE(ssh->state == UNIT_STATE_ENABLED);
+  REQUIRE(ssh->sub == UNIT_SUBSTATE_RUNNING);
+  /*
+   * Only units without a unit file ask for their state
+   */
+  REQUIRE(fake.getCalls("GetUnitFileState") - stateCalls ==
+      (unsigned long)(fake.unitsCount() - fake.filesCount()));
+
+  delete ctl;
+}
+
+TEST_CASE("should stop and start units on fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  UnitItem *ssh = ctl->findItem(FAKE_SSH_UNIT);
+
+  REQUIRE_NOTHROW(ctl->toggleUnitSubState(ssh));
+  REQUIRE(ssh->sub == UNIT_SUBSTATE_TMP);
+  REQUIRE(waitFor(ctl, [ssh]() { return ssh->sub != UNIT_SUBSTATE_TMP; }));
+  REQUIRE(ssh->sub != UNIT_SUBSTATE_RUNNING);
+  REQUIRE(fake.getUnit(FAKE_SSH_UNIT).sub == "dead");
+
+  REQUIRE_NOTHROW(ctl->toggleUnitSubState(ssh));
+  REQUIRE(waitFor(ctl, [ssh]() { return ssh->sub == UNIT_SUBSTATE_RUNNING; }));
+
+  delete ctl;
+}
+
+TEST_CASE("should follow units added and removed on fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  fake.addUnit("extra.service", "disabled");
+
+  REQUIRE(waitFor(ctl, [ctl]() {
+    UnitItem *item = ctl->findItem("extra.service");
+    return item != NULL && item->state == UNIT_STATE_DISABLED;
+  }));
+
+  fake.removeUnit("extra.service");
+
+  REQUIRE(waitFor(ctl, [ctl]() {
+    return ctl->findItem("extra.service")->sub == UNIT_SUBSTATE_INVALID;
+  }));
+
+  delete ctl;
+}
+
+TEST_CASE("should drop removed units without a unit file on fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  int count = ctl->getItems().size();
+
+  /*
+   * Transient units come and go, the list must not grow with them
+   */
+  for (int i = 0; i < 20; i++) {
+    string id = "run-" + to_string(i) + ".scope";
+
+    fake.addUnit(id.c_str(), "");
+    REQUIRE(waitFor(ctl, [ctl, &id]() { return ctl->findItem(id.c_str()) != NULL; }));
+
+    fake.removeUnit(id.c_str());
+    REQUIRE(waitFor(ctl, [ctl, &id]() { return ctl->findItem(id.c_str()) == NULL; }));
+  }
+
+  REQUIRE((int)ctl->getItems().size() == count);
+
+  /*
+   * So do loaded units without a unit file from the fetch,
+   * unit files stay
+   */
+  REQUIRE(ctl->findItem("fake-dev0.device") != NULL);
+  fake.removeUnit("fake-dev0.device");
+  fake.removeUnit(FAKE_SSH_UNIT);
+
+  REQUIRE(waitFor(ctl, [ctl]() {
+    return ctl->findItem("fake-dev0.device") == NULL &&
+      ctl->findItem(FAKE_SSH_UNIT)->sub == UNIT_SUBSTATE_INVALID;
+  }));
+
+  REQUIRE((int)ctl->getItems().size() == count - 1);
+
+  for (auto item : ctl->getItems()) {
+    REQUIRE(ctl->findItem(item->id.c_str()) == item);
+  }
+
+  delete ctl;
+}
+
+TEST_CASE("should drop a transient unit removed during a fetch", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.addUnit("run-1.service", "transient");
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+
+  /*
+   * The unit files are pushed, the loaded units are merged next
+   */
+  ctl->fetchStart();
+  ctl->fetchNext();
+
+  REQUIRE(ctl->isFetching());
+  REQUIRE(ctl->findItem("run-1.service") != NULL);
+
+  fake.removeUnit("run-1.service");
+
+  REQUIRE(waitFor(ctl, [ctl]() { return ctl->findItem("run-1.service") == NULL; }));
+  REQUIRE(ctl->isFetching());
+
+  while (ctl->isFetching()) {
+    REQUIRE_NOTHROW(ctl->fetchNext());
+  }
+
+  REQUIRE(ctl->findItem("run-1.service") == NULL);
+  REQUIRE((int)ctl->getItems().size() == fake.unitsCount() - 1);
+
+  for (auto item : ctl->getItems()) {
+    REQUIRE(ctl->findItem(item->id.c_str()) == item);
+  }
+
+  delete ctl;
+}
+
+TEST_CASE("should reconnect and fetch again after a bus restart", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  /*
+   * Asked right before the restart, the answers never come
+   */
+  for (auto item : ctl->getItems()) {
+    ctl->bus->requestState(item->id.c_str());
+  }
+
+  fake.stop();
+  fake.start();
+
+  REQUIRE(waitFor(ctl, [ctl]() {
+    while (ctl->isFetching()) {
+      ctl->fetchNext();
+    }
+    return ctl->bus->getStats().reconnects > 0;
+  }));
+
+  REQUIRE(ctl->bus->getStats().reconnects == 1);
+  REQUIRE(fake.getCalls("ListUnitFiles") == 2);
+  REQUIRE(fake.getCalls("Subscribe") == 2);
+  REQUIRE((int)ctl->getItems().size() == fake.unitsCount());
+
+  /*
+   * Signals come on the new connection
+   */
+  fake.addUnit("extra.service", "disabled");
+
+  REQUIRE(waitFor(ctl, [ctl]() {
+    UnitItem *item = ctl->findItem("extra.service");
+    return item != NULL && item->state == UNIT_STATE_DISABLED;
+  }));
+
+  delete ctl;
+}
+
+TEST_CASE("should disable units still enabled only once more", "[FakeSystemd]") {
+  FakeSystemd fake(20);
+
+  /*
+   * The fake leaves runtime enabled units as they are
+   */
+  fake.addUnit("stuck.service", "enabled-runtime");
+  fake.start();
+
+  ChkBus *bus = new ChkBus();
+  set<string> ids = { FAKE_SSH_UNIT, "stuck.service" };
+
+  REQUIRE_NOTHROW(bus->disableUnits(&ids));
+  REQUIRE(fake.getCalls("DisableUnitFiles") == 3);
+  REQUIRE(fake.getUnit(FAKE_SSH_UNIT).state == "disabled");
+  REQUIRE(fake.getUnit("stuck.service").state == "enabled-runtime");
+
+  delete bus;
+}
+
+static void freeUnits(vector<UnitInfo *> *units) {
+  for (auto unit : (*units)) {
+    ChkBus::freeUnitInfo(unit);
+    delete unit;
+  }
+  units->clear();
+}
+
+TEST_CASE("should post a toggle whole or not at all", "[FakeSystemd]") {
+  FakeSystemd fake(20, 50000);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  UnitItem *ssh = ctl->findItem(FAKE_SSH_UNIT);
+
+  REQUIRE(ssh->state == UNIT_STATE_ENABLED);
+  REQUIRE(ssh->sub == UNIT_SUBSTATE_RUNNING);
+
+  /*
+   * The worker is busy with the first job long enough to leave
+   * a single free slot, stop and disable need two
+   */
+  while (ctl->worker->post(WORKER_OP_START, "fake-1.socket")) {
+  }
+
+  while (ctl->worker->space() == 0) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+
+  REQUIRE(ctl->worker->space() == 1);
+  REQUIRE_THROWS(ctl->toggleUnitState(ssh));
+  REQUIRE(ssh->state == UNIT_STATE_ENABLED);
+  REQUIRE(ssh->sub == UNIT_SUBSTATE_RUNNING);
+
+  REQUIRE_THROWS(ctl->toggleUnitStates({ ssh }));
+  REQUIRE(ssh->state == UNIT_STATE_ENABLED);
+  REQUIRE(ssh->sub == UNIT_SUBSTATE_RUNNING);
+  REQUIRE(ctl->worker->space() == 1);
+
+  delete ctl;
+}
+
+TEST_CASE("should not wait for queued units when the worker goes", "[FakeSystemd]") {
+  FakeSystemd fake(20, 100000);
+  fake.start();
+
+  ChkBus *bus = new ChkBus();
+  UnitArena arena;
+  vector<string> ids;
+
+  for (auto file : bus->getUnitFiles(&arena)) {
+    ids.push_back(file->id);
+  }
+
+  ChkWorker *worker = new ChkWorker();
+
+  REQUIRE(worker->post(WORKER_OP_STOP, ids));
+
+  while (fake.getCalls("StopUnit") == 0) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+
+  auto began = chrono::steady_clock::now();
+  delete worker;
+
+  REQUIRE(chrono::steady_clock::now() - began < chrono::milliseconds(500));
+  REQUIRE(fake.getCalls("StopUnit") < ids.size());
+
+  delete bus;
+}
+
+TEST_CASE("should list units in scope from fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.start();
+
+  ChkBus *bus = new ChkBus();
+  vector<UnitInfo *> units;
+  UnitScope scope;
+
+  REQUIRE_FALSE(bus->isScoped());
+
+  /*
+   * Every fifth fake unit is a service, every twentieth a device,
+   * plus ssh.service
+   */
+  scope.types = { "service" };
+  bus->setScope(scope);
+
+  REQUIRE(bus->isScoped());
+  REQUIRE(bus->inScope("app.service"));
+  REQUIRE_FALSE(bus->inScope("app.timer"));
+  REQUIRE_NOTHROW((units = bus->getAllUnits()));
+  REQUIRE(units.size() == 16);
+
+  for (auto unit : units) {
+    REQUIRE(string(unit->id).find(".service") != string::npos);
+  }
+
+  freeUnits(&units);
+
+  REQUIRE(fake.getCalls("ListUnits") == 0);
+  REQUIRE(fake.getCalls("ListUnitFiles") == 0);
+  REQUIRE(fake.getCalls("ListUnitsByPatterns") == 1);
+  REQUIRE(fake.getCalls("ListUnitFilesByPatterns") == 1);
+
+  /*
+   * Loaded units of every fourth fake unit run, devices included
+   */
+  scope = UnitScope();
+  scope.states = { "running" };
+  bus->setScope(scope);
+
+  REQUIRE(bus->inScope("app.timer"));
+  REQUIRE_NOTHROW((units = bus->getAllUnits()));
+  REQUIRE(units.size() == 26);
+
+  for (auto unit : units) {
+    REQUIRE(string(unit->subState) == "running");
+  }
+
+  freeUnits(&units);
+
+  scope = UnitScope();
+  scope.types = { "service", "timer" };
+  scope.states = { "enabled" };
+  scope.patterns = { "fake-1*" };
+  bus->setScope(scope);
+
+  REQUIRE(bus->inScope("fake-12.timer"));
+  REQUIRE_FALSE(bus->inScope("fake-12.socket"));
+  REQUIRE_FALSE(bus->inScope("fake-22.timer"));
+  REQUIRE_NOTHROW((units = bus->getAllUnits()));
+  REQUIRE_FALSE(units.empty());
+
+  for (auto unit : units) {
+    REQUIRE(string(unit->id).find("fake-1") == 0);
+    REQUIRE(string(unit->state) == "enabled");
+  }
+
+  freeUnits(&units);
+
+  delete bus;
+}
+
+TEST_CASE("should fetch units progressively from fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(5000);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  int steps = 0;
+
+  REQUIRE_NOTHROW(ctl->fetchStart());
+  REQUIRE(ctl->isFetching());
+  REQUIRE(ctl->fetchNext() == UNIT_UPDATE_LIST);
+  REQUIRE(ctl->getItems().size() == FETCH_FIRST_BATCH);
+
+  while (ctl->isFetching()) {
+    REQUIRE_NOTHROW(ctl->fetchNext());
+    steps++;
+  }
+
+  REQUIRE(steps > 2);
+  REQUIRE((int)ctl->getItems().size() == fake.unitsCount());
+
+  /*
+   * Same units and states as a fetch in one go
+   */
+  ChkBus *bus = new ChkBus();
+  vector<UnitInfo *> units = bus->getAllUnits();
+
+  REQUIRE(units.size() == ctl->getItems().size());
+
+  for (auto unit : units) {
+    UnitItem *item = ctl->findItem(unit->id);
+
+    REQUIRE(item != NULL);
+
+    /*
+     * Devices have no unit file state
+     */
+    if (unit->state == NULL) {
+      REQUIRE(item->state == UNIT_STATE_MASKED);
+      continue;
+    }
+
+    REQUIRE((item->state == UNIT_STATE_ENABLED) == (string(unit->state) == "enabled"));
+    REQUIRE(item->sub == (unit->subState == NULL ? UNIT_SUBSTATE_INVALID :
+        string(unit->subState) == "running" ? UNIT_SUBSTATE_RUNNING : UNIT_SUBSTATE_CONNECTED));
+  }
+
+  freeUnits(&units);
+
+  delete bus;
+  delete ctl;
+}
+
+TEST_CASE("should load details of shown units from fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  vector<UnitItem *> items = ctl->getItemsSorted();
+  UnitItem *unloaded = NULL;
+  int page = 40;
+
+  for (int i = 0; i < page && unloaded == NULL; i++) {
+    if (!items[i]->id.empty() && !items[i]->detailed) {
+      unloaded = items[i];
+    }
+  }
+
+  REQUIRE(unloaded != NULL);
+  REQUIRE(unloaded->description[0] == '/');
+
+  std::string id(unloaded->id);
+
+  /*
+   * Only the page asked for is loaded, with one call per unit
+   */
+  REQUIRE_NOTHROW(ctl->loadDetails(items, 0, page));
+  REQUIRE(waitFor(ctl, [&items, page]() {
+    for (int i = 0; i < page; i++) {
+      if (!items[i]->id.empty() && !items[i]->detailed) {
+        return false;
+      }
+    }
+    return true;
+  }));
+
+  unsigned long calls = fake.getCalls("Description");
+
+  REQUIRE(calls > 0);
+  REQUIRE(calls < (unsigned long)page);
+  REQUIRE(string(unloaded->description) == fake.getUnit(id.c_str()).description);
+  REQUIRE(unloaded->lineWidth == 0);
+
+  /*
+   * A reload takes them from the cache
+   */
+  ctl->fetch();
+  items = ctl->getItemsSorted();
+  unloaded = ctl->findItem(id.c_str());
+
+  REQUIRE(unloaded->detailed == false);
+  REQUIRE(ctl->loadDetails(items, 0, page) == UNIT_UPDATE_ROWS);
+  REQUIRE(unloaded->detailed == true);
+  REQUIRE(string(unloaded->description) == fake.getUnit(id.c_str()).description);
+  REQUIRE(fake.getCalls("Description") == calls);
+
+  /*
+   * Changed properties drop the cached details
+   */
+  REQUIRE_NOTHROW(ctl->toggleUnitSubState(unloaded));
+  REQUIRE(waitFor(ctl, [unloaded]() { return unloaded->detailed == false; }));
+
+  REQUIRE_NOTHROW(ctl->loadDetails(items, 0, page));
+  REQUIRE(waitFor(ctl, [unloaded]() { return unloaded->detailed == true; }));
+  REQUIRE(fake.getCalls("Description") == calls + 1);
+
+  delete ctl;
+}
+
+TEST_CASE("should ask again for details not answered in time", "[FakeSystemd]") {
+  FakeSystemd fake(100);
+  fake.start();
+
+  /*
+   * Calls of the connection opened next time out after a second
+   */
+  setenv("SYSTEMD_BUS_TIMEOUT", "1s", 1);
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  vector<UnitItem *> items = ctl->getItemsSorted();
+  int row = 0;
+
+  while (items[row]->id.empty() || items[row]->detailed) {
+    row++;
+  }
+
+  fake.silenceUnit(items[row]->id.c_str());
+
+  REQUIRE_NOTHROW(ctl->loadDetails(items, row, 1));
+  REQUIRE(waitFor(ctl, [&fake]() { return fake.getCalls("GetAll") == 1; }));
+
+  REQUIRE(waitFor(ctl, [ctl, &items, &fake, row]() {
+    ctl->loadDetails(items, row, 1);
+    return fake.getCalls("GetAll") == 2;
+  }));
+  REQUIRE(items[row]->detailed == false);
+
+  unsetenv("SYSTEMD_BUS_TIMEOUT");
+
+  delete ctl;
+}
+
+TEST_CASE("should toggle marked units with one call on fake systemd", "[FakeSystemd]") {
+  FakeSystemd fake(400);
+  fake.start();
+
+  ChkCTL *ctl = new ChkCTL();
+  ctl->fetch();
+
+  vector<UnitItem *> items;
+
+  /*
+   * Enabled units that are not loaded, nothing has to be stopped
+   */
+  for (auto item : ctl->getItems()) {
+    if (item->state == UNIT_STATE_ENABLED && item->sub == UNIT_SUBSTATE_INVALID &&
+        items.size() < 50) {
+      items.push_back(item);
+    }
+  }
+
+  REQUIRE(items.size() == 50);
+
+  REQUIRE_NOTHROW(ctl->toggleUnitStates(items));
+
+  for (auto item : items) {
+    REQUIRE(item->state == UNIT_STATE_TMP);
+  }
+
+  REQUIRE(waitFor(ctl, [&items]() {
+    for (auto item : items) {
+      if (item->state != UNIT_STATE_DISABLED) {
+        return false;
+      }
+    }
+    return true;
+  }));
+
+  REQUIRE(fake.getCalls("DisableUnitFiles") == 1);
+  REQUIRE(waitFor(ctl, [&fake]() { return fake.getCalls("Reload") == 1; }));
+  REQUIRE(fake.getCalls("StopUnit") == 0);
+  REQUIRE(fake.getUnit(items[0]->id.c_str()).state == "disabled");
+
+  REQUIRE_NOTHROW(ctl->toggleUnitStates(items));
+  REQUIRE(waitFor(ctl, [&items]() {
+    for (auto item : items) {
+      if (item->state != UNIT_STATE_ENABLED) {
+        return false;
+      }
+    }
+    return true;
+  }));
+
+  REQUIRE(fake.getCalls("EnableUnitFiles") == 1);
+  REQUIRE(waitFor(ctl, [&fake]() { return fake.getCalls("Reload") == 2; }));
+
+  delete ctl;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <catch.hpp>
+
+#include "chk-search.h"
+
+using namespace std;
+
+static UnitItem *makeItem(const char *id, const char *description) {
+  UnitItem *item = new UnitItem();
+
+  item->id = id;
+  item->description = description;
+
+  return item;
+}
+
+TEST_CASE("should find units by id and description", "[ChkSearch]") {
+  vector<UnitItem *> rows;
+  ChkSearch search;
+
+  rows.push_back(makeItem("ssh.service", "OpenBSD Secure Shell server"));
+  rows.push_back(makeItem("", ""));
+  rows.push_back(makeItem("cron.service", "Regular background program processing"));
+  rows.push_back(makeItem("app-worker@1.service", "Worker"));
+  rows.push_back(makeItem("app-worker@2.service", "Worker"));
+
+  search.build(rows);
+
+  REQUIRE(search.find("SSH").size() == 1);
+  REQUIRE(search.isMatch(0) == true);
+
+  REQUIRE(search.find("worker").size() == 2);
+  REQUIRE(search.isMatch(0) == false);
+  REQUIRE(search.isMatch(3) == true);
+
+  REQUIRE(search.find("worker@2").size() == 1);
+  REQUIRE(search.isMatch(3) == false);
+
+  REQUIRE(search.find("worker").size() == 2);
+  REQUIRE(search.find("background").size() == 1);
+  REQUIRE(search.find("nothing").size() == 0);
+  REQUIRE(search.find("r").size() == 4);
+
+  for (auto row : rows) {
+    delete row;
+  }
+}
+
+TEST_CASE("should move between matches with wrap around", "[ChkSearch]") {
+  vector<UnitItem *> rows;
+  ChkSearch search;
+
+  rows.push_back(makeItem("a.service", ""));
+  rows.push_back(makeItem("b.timer", ""));
+  rows.push_back(makeItem("c.service", ""));
+
+  search.build(rows);
+  search.find("service");
+
+  REQUIRE(search.next(0) == 2);
+  REQUIRE(search.next(2) == 0);
+  REQUIRE(search.prev(2) == 0);
+  REQUIRE(search.prev(0) == 2);
+
+  search.clear();
+
+  REQUIRE(search.next(0) == -1);
+  REQUIRE(search.isMatch(0) == false);
+
+  for (auto row : rows) {
+    delete row;
+  }
+}
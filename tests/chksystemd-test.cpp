@@ -1,8 +1,10 @@
 #include <iostream>
 #include <catch.hpp>
 #include <map>
+#include <cstring>
 
 #include "chk-systemd.h"
+#include "fake-systemd.h"
 
 using namespace std;
 
@@ -16,6 +18,9 @@ TEST_CASE("should create object bus", "[ChkBus]") {
 }
 
 TEST_CASE("should connect to systemd bus", "[ChkBus]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkBus *bus = new ChkBus();
 
   REQUIRE_NOTHROW(bus->connect());
@@ -26,7 +31,30 @@ TEST_CASE("should connect to systemd bus", "[ChkBus]") {
   delete bus;
 }
 
+TEST_CASE("should reuse connection between calls", "[ChkBus]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
+  ChkBus *bus = new ChkBus();
+
+  REQUIRE_NOTHROW(bus->getUnitFiles());
+  REQUIRE_NOTHROW(bus->getUnits());
+  REQUIRE_NOTHROW(bus->reloadDaemon());
+  REQUIRE(bus->isConnected() == true);
+
+  ChkBusStats stats = bus->getStats();
+
+  REQUIRE(stats.connects == 1);
+  REQUIRE(stats.reuses >= 2);
+  REQUIRE(stats.reconnects == 0);
+
+  delete bus;
+}
+
 TEST_CASE("should get list of unit files", "[ChkBus]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkBus *bus = new ChkBus();
   bool sshServiceFound = false;
 
@@ -41,12 +69,24 @@ TEST_CASE("should get list of unit files", "[ChkBus]") {
     if (path.find(id) == std::string::npos) {
       REQUIRE( true == false );
     }
+
+    if (id == FAKE_SSH_UNIT) {
+      sshServiceFound = true;
+    }
+
+    foundCount++;
   }
 
+  REQUIRE(sshServiceFound == true);
+  REQUIRE(foundCount == fake.filesCount());
+
   delete bus;
 }
 
 TEST_CASE("should get list of units", "[ChkBus]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkBus *bus = new ChkBus();
   bool sshServiceFound = false;
 
@@ -71,6 +111,9 @@ TEST_CASE("should get list of units", "[ChkBus]") {
 }
 
 TEST_CASE("should get all units", "[ChkBus]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkBus *bus = new ChkBus();
 
   auto allUnits = bus->getAllUnits();
@@ -85,6 +128,9 @@ TEST_CASE("should get all units", "[ChkBus]") {
 }
 
 TEST_CASE("should be able enable/disable unit", "[ChkBus]") {
+  FakeSystemd fake(1000);
+  fake.start();
+
   ChkBus *bus = new ChkBus();
 
   REQUIRE_NOTHROW(bus->enableUnit("ssh.service"));
@@ -109,6 +155,81 @@ TEST_CASE("should be able enable/disable unit", "[ChkBus]") {
   delete bus;
 }
 
+static UnitInfo *makeUnit(const char *id, const char *state) {
+  UnitInfo *unit = new UnitInfo();
+
+  unit->id = strdup(id);
+  unit->unitPath = strdup(id);
+  unit->state = state == NULL ? NULL : strdup(state);
+
+  return unit;
+}
+
+TEST_CASE("should merge units into unit files by prefix", "[ChkBus]") {
+  vector<UnitInfo *> files;
+  vector<UnitInfo *> units;
+  vector<UnitInfo *> orphans;
+
+  files.push_back(makeUnit("a.service", "enabled"));
+  files.push_back(makeUnit("b.service", "disabled"));
+  files.push_back(makeUnit("getty@", "static"));
+  files.push_back(makeUnit("b.serv", "masked"));
+
+  units.push_back(makeUnit("b.service", NULL));
+  units.push_back(makeUnit("getty@tty1.service", NULL));
+  units.push_back(makeUnit("c.service", NULL));
+
+  ChkBus::mergeUnits(&files, &units, &orphans);
+
+  REQUIRE(files.size() == 4);
+  REQUIRE(string(files[1]->id) == "b.service");
+  REQUIRE(string(files[1]->state) == "disabled");
+  REQUIRE(string(files[2]->id) == "getty@tty1.service");
+  REQUIRE(string(files[3]->id) == "b.serv");
+
+  REQUIRE(orphans.size() == 1);
+  REQUIRE(string(orphans[0]->id) == "c.service");
+}
+
+TEST_CASE("should merge units renamed many times over", "[ChkBus]") {
+  vector<UnitInfo *> files;
+  vector<UnitInfo *> units;
+  vector<UnitInfo *> orphans;
+  vector<string> ids;
+
+  for (int i = 0; i < 100; i++) {
+    ids.push_back("unit-" + to_string(i));
+    files.push_back(makeUnit(ids.back().c_str(), "static"));
+  }
+
+  /*
+   * Every unit takes the file renamed by the one before,
+   * each rename leaves a removed slot behind
+   */
+  for (int round = 0; round < 50; round++) {
+    for (auto &id : ids) {
+      id += (char)('a' + round % 26);
+      units.push_back(makeUnit(id.c_str(), NULL));
+    }
+  }
+
+  units.push_back(makeUnit("other.service", NULL));
+
+  ChkBus::mergeUnits(&files, &units, &orphans);
+
+  REQUIRE(files.size() == 100);
+  REQUIRE(orphans.size() == 1);
+
+  for (size_t i = 0; i < files.size(); i++) {
+    REQUIRE(string(files[i]->id) == ids[i]);
+    ChkBus::freeUnitInfo(files[i]);
+    delete files[i];
+  }
+
+  ChkBus::freeUnitInfo(orphans[0]);
+  delete orphans[0];
+}
+
 /*
  * Travis related
  * It does not load a full featured environment therefore this test does not pass
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <catch.hpp>
+
+#include "chk-ctl.h"
+
+using namespace std;
+
+static UnitItem *makeItem(const char *id, const char *target, int state, int sub) {
+  UnitItem *item = new UnitItem();
+
+  item->id = id;
+  item->target = target;
+  item->state = state;
+  item->sub = sub;
+
+  return item;
+}
+
+TEST_CASE("should keep rows and select units by type", "[UnitTable]") {
+  UnitTable table;
+  vector<int> rows;
+
+  table.typeId("service");
+
+  table.add(makeItem("ssh.service", "service", UNIT_STATE_ENABLED, UNIT_SUBSTATE_RUNNING));
+  table.add(makeItem("tmp.mount", "mount", UNIT_STATE_STATIC, UNIT_SUBSTATE_CONNECTED));
+  table.add(makeItem("cron.service", "service", UNIT_STATE_DISABLED, UNIT_SUBSTATE_INVALID));
+
+  REQUIRE(table.size() == 3);
+  REQUIRE(table.typeId("service") == 0);
+  REQUIRE(table.type(1) == table.typeId("mount"));
+  REQUIRE(table.item(2)->row == 2);
+
+  table.setState(2, UNIT_STATE_ENABLED);
+  table.setSub(2, UNIT_SUBSTATE_RUNNING);
+
+  REQUIRE(table.item(2)->state == UNIT_STATE_ENABLED);
+  REQUIRE(table.item(2)->sub == UNIT_SUBSTATE_RUNNING);
+
+  table.selectByType("serv", &rows);
+  REQUIRE(rows == vector<int>({ 0, 2 }));
+
+  for (auto item : table.getItems()) {
+    delete item;
+  }
+
+  table.clear();
+
+  REQUIRE(table.size() == 0);
+  REQUIRE(table.typeId("mount") == 1);
+}
+
+TEST_CASE("should move the last row into a removed one", "[UnitTable]") {
+  UnitTable table;
+  vector<int> rows;
+
+  UnitItem *ssh = makeItem("ssh.service", "service", UNIT_STATE_ENABLED, UNIT_SUBSTATE_RUNNING);
+  UnitItem *scope = makeItem("run-1.scope", "scope", UNIT_STATE_TMP, UNIT_SUBSTATE_RUNNING);
+  UnitItem *mount = makeItem("tmp.mount", "mount", UNIT_STATE_STATIC, UNIT_SUBSTATE_CONNECTED);
+
+  table.add(ssh);
+  table.add(scope);
+  table.add(mount);
+  table.remove(1);
+
+  REQUIRE(table.size() == 2);
+  REQUIRE(scope->row == -1);
+  REQUIRE(table.item(1) == mount);
+  REQUIRE(mount->row == 1);
+  REQUIRE(table.type(1) == table.typeId("mount"));
+
+  table.selectByType("mount", &rows);
+  REQUIRE(rows == vector<int>({ 1 }));
+
+  table.remove(1);
+
+  REQUIRE(table.size() == 1);
+  REQUIRE(table.item(0) == ssh);
+
+  delete ssh;
+  delete scope;
+  delete mount;
+}
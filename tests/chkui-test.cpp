@@ -1,10 +1,70 @@
 #include <iostream>
+#include <cstdlib>
+#include <set>
+#include <unistd.h>
 #include <catch.hpp>
 
 #include "chk-ui.h"
+#include "fake-systemd.h"
 
 using namespace std;
 
+/*
+ * Curses screen drawn to /dev/null, windows get their keys from
+ * handleKey instead of a terminal
+ */
+class HeadlessScreen {
+  public:
+    HeadlessScreen(int lines, int columns) {
+      const char *term = getenv("TERM");
+
+      out = fopen("/dev/null", "w");
+      in = fopen("/dev/null", "r");
+      screen = newterm(term != NULL ? term : "xterm", out, in);
+
+      if (screen != NULL) {
+        set_term(screen);
+        resize_term(lines, columns);
+        setupCurses();
+      }
+    }
+
+    ~HeadlessScreen() {
+      if (screen != NULL) {
+        endwin();
+        delscreen(screen);
+      }
+
+      fclose(out);
+      fclose(in);
+    }
+
+    bool isOpen() {
+      return screen != NULL;
+    }
+
+  private:
+    SCREEN *screen;
+    FILE *out;
+    FILE *in;
+};
+
+static void sendKeys(MainWindow *window, const char *keys) {
+  for (const char *key = keys; *key != 0; key++) {
+    window->handleKey(*key);
+    window->drawUnits();
+  }
+}
+
+static void loadAll(MainWindow *window) {
+  window->drawUnits();
+
+  while (window->isLoading()) {
+    window->applyUpdates();
+    window->drawUnits();
+  }
+}
+
 TEST_CASE("should create window", "[ChkUI]") {
   MainWindow *win = new MainWindow();
 
@@ -12,3 +72,205 @@ TEST_CASE("should create window", "[ChkUI]") {
 
   delete win;
 }
+
+TEST_CASE("should ignore unit keys in an empty filter view", "[ChkUI]") {
+  HeadlessScreen screen(24, 80);
+  REQUIRE(screen.isOpen());
+
+  FakeSystemd fake(100);
+  fake.start();
+
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  loadAll(window);
+
+  REQUIRE(window->getCursorUnit() != NULL);
+
+  /*
+   * A % in the filter is drawn as it is
+   */
+  sendKeys(window, "F%s%n-nothing\n");
+
+  REQUIRE(window->totalUnits() == 0);
+  REQUIRE(window->getCursorUnit() == NULL);
+  REQUIRE(window->getCursorPosition() == 0);
+
+  sendKeys(window, " sjkfbGgmva* ");
+
+  REQUIRE(window->getCursorUnit() == NULL);
+  REQUIRE(fake.getCalls("StartUnit") == 0);
+  REQUIRE(fake.getCalls("StopUnit") == 0);
+  REQUIRE(fake.getCalls("EnableUnitFiles") == 0);
+  REQUIRE(fake.getCalls("DisableUnitFiles") == 0);
+
+  delete window;
+}
+
+TEST_CASE("should search for text with format characters", "[ChkUI]") {
+  HeadlessScreen screen(24, 80);
+  REQUIRE(screen.isOpen());
+
+  FakeSystemd fake(100);
+  fake.start();
+
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  loadAll(window);
+
+  sendKeys(window, "/%s%n%%");
+
+  REQUIRE(window->getCursorUnit() != NULL);
+
+  sendKeys(window, "\n/ssh\n");
+
+  REQUIRE(string(window->getCursorUnit()->id) == FAKE_SSH_UNIT);
+
+  delete window;
+}
+
+TEST_CASE("should filter the new list again after backspace", "[ChkUI]") {
+  HeadlessScreen screen(24, 80);
+  REQUIRE(screen.isOpen());
+
+  FakeSystemd fake(1000);
+  fake.start();
+
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  loadAll(window);
+
+  sendKeys(window, "Ffake-1");
+  int narrow = window->totalUnits();
+
+  /*
+   * A unit added by a signal rebuilds the list under the filter
+   */
+  fake.addUnit("fake-1extra.service", "disabled");
+
+  for (int i = 0; i < 1000 && window->totalUnits() == narrow; i++) {
+    window->applyUpdates();
+    usleep(5000);
+  }
+
+  REQUIRE(window->totalUnits() == narrow + 1);
+
+  window->handleKey(KEY_BACKSPACE);
+  int wide = window->totalUnits();
+
+  REQUIRE(wide > narrow + 1);
+
+  sendKeys(window, "\x1b" "Ffake-");
+
+  REQUIRE(window->totalUnits() == wide);
+
+  delete window;
+}
+
+TEST_CASE("should step over separators to the ends of the list", "[ChkUI]") {
+  HeadlessScreen screen(24, 80);
+  REQUIRE(screen.isOpen());
+
+  FakeSystemd fake(100);
+  fake.start();
+
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  loadAll(window);
+
+  int total = window->totalUnits();
+  REQUIRE(total == 101);
+
+  sendKeys(window, "g");
+  UnitItem *first = window->getCursorUnit();
+
+  REQUIRE(first != NULL);
+  REQUIRE(window->getCursorPosition() == 1);
+
+  sendKeys(window, "k");
+
+  REQUIRE(window->getCursorUnit() == first);
+  REQUIRE(window->getCursorPosition() == 1);
+
+  /*
+   * Every unit once, in order, never a separator
+   */
+  set<UnitItem *> seen = { first };
+
+  for (int position = 2; position <= total; position++) {
+    sendKeys(window, "j");
+
+    REQUIRE(window->getCursorUnit() != NULL);
+    REQUIRE(window->getCursorPosition() == position);
+    seen.insert(window->getCursorUnit());
+  }
+
+  REQUIRE((int)seen.size() == total);
+
+  UnitItem *last = window->getCursorUnit();
+  sendKeys(window, "j");
+
+  REQUIRE(window->getCursorUnit() == last);
+  REQUIRE(window->getCursorPosition() == total);
+
+  sendKeys(window, "gG");
+
+  REQUIRE(window->getCursorUnit() == last);
+  REQUIRE(window->getCursorPosition() == total);
+
+  for (int position = total - 1; position >= 1; position--) {
+    sendKeys(window, "k");
+
+    REQUIRE(window->getCursorUnit() != NULL);
+    REQUIRE(window->getCursorPosition() == position);
+  }
+
+  REQUIRE(window->getCursorUnit() == first);
+
+  delete window;
+}
+
+TEST_CASE("should page onto units only and stop at the ends", "[ChkUI]") {
+  HeadlessScreen screen(24, 80);
+  REQUIRE(screen.isOpen());
+
+  FakeSystemd fake(100);
+  fake.start();
+
+  MainWindow *window = new MainWindow();
+  window->createWindow();
+  loadAll(window);
+
+  int total = window->totalUnits();
+  int pages = 0;
+
+  sendKeys(window, "g");
+
+  while (window->getCursorPosition() < total) {
+    int position = window->getCursorPosition();
+    sendKeys(window, "f");
+
+    REQUIRE(window->getCursorUnit() != NULL);
+    REQUIRE(window->getCursorPosition() > position);
+    REQUIRE(++pages < total);
+  }
+
+  sendKeys(window, "f");
+
+  REQUIRE(window->getCursorPosition() == total);
+  REQUIRE(pages > 1);
+
+  while (window->getCursorPosition() > 1) {
+    int position = window->getCursorPosition();
+    sendKeys(window, "b");
+
+    REQUIRE(window->getCursorUnit() != NULL);
+    REQUIRE(window->getCursorPosition() < position);
+    REQUIRE(--pages > -total);
+  }
+
+  sendKeys(window, "b");
+
+  REQUIRE(window->getCursorPosition() == 1);
+
+  delete window;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <catch.hpp>
+#include <thread>
+
+#include "chk-worker.h"
+
+using namespace std;
+
+TEST_CASE("should keep queue order and capacity", "[ChkWorker]") {
+  SpscQueue<int, 4> queue;
+  int value = 0;
+
+  REQUIRE(queue.pop(&value) == false);
+  REQUIRE(queue.space() == 3);
+  REQUIRE(queue.push(1) == true);
+  REQUIRE(queue.push(2) == true);
+  REQUIRE(queue.space() == 1);
+  REQUIRE(queue.push(3) == true);
+  REQUIRE(queue.space() == 0);
+  REQUIRE(queue.push(4) == false);
+
+  REQUIRE(queue.pop(&value) == true);
+  REQUIRE(value == 1);
+  REQUIRE(queue.space() == 1);
+  REQUIRE(queue.push(4) == true);
+  REQUIRE(queue.space() == 0);
+
+  REQUIRE(queue.pop(&value) == true);
+  REQUIRE(value == 2);
+  REQUIRE(queue.pop(&value) == true);
+  REQUIRE(value == 3);
+  REQUIRE(queue.pop(&value) == true);
+  REQUIRE(value == 4);
+  REQUIRE(queue.pop(&value) == false);
+}
+
+TEST_CASE("should pass items between two threads", "[ChkWorker]") {
+  SpscQueue<int, 16> queue;
+  const int count = 100000;
+  long sum = 0;
+
+  thread producer([&queue]() {
+    for (int i = 1; i <= count; i++) {
+      while (!queue.push(i)) {
+        this_thread::yield();
+      }
+    }
+  });
+
+  for (int received = 0; received < count; ) {
+    int value;
+
+    if (queue.pop(&value)) {
+      sum += value;
+      received++;
+    } else {
+      this_thread::yield();
+    }
+  }
+
+  producer.join();
+
+  REQUIRE(sum == (long)count * (count + 1) / 2);
+}
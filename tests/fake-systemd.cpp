@@ -0,0 +1,855 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fnmatch.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "chk-worker.h"
+#include "fake-systemd.h"
+
+#define FAKE_UNIT_PREFIX "/org/freedesktop/systemd1/unit"
+#define FAKE_MANAGER_PATH "/org/freedesktop/systemd1"
+#define FAKE_MANAGER_INTERFACE "org.freedesktop.systemd1.Manager"
+
+const sd_bus_vtable FakeSystemd::driverVtable[] = {
+  SD_BUS_VTABLE_START(0),
+  SD_BUS_METHOD("Hello", "", "s", FakeSystemd::onHello, 0),
+  SD_BUS_METHOD("AddMatch", "s", "", FakeSystemd::onMatch, 0),
+  SD_BUS_METHOD("RemoveMatch", "s", "", FakeSystemd::onMatch, 0),
+  SD_BUS_VTABLE_END
+};
+
+const sd_bus_vtable FakeSystemd::managerVtable[] = {
+  SD_BUS_VTABLE_START(0),
+  SD_BUS_METHOD("Subscribe", "", "", FakeSystemd::onEmpty, 0),
+  SD_BUS_METHOD("Reload", "", "", FakeSystemd::onEmpty, 0),
+  SD_BUS_METHOD("ListUnits", "", "a(ssssssouso)", FakeSystemd::onListUnits, 0),
+  SD_BUS_METHOD("ListUnitFiles", "", "a(ss)", FakeSystemd::onListUnitFiles, 0),
+  SD_BUS_METHOD("ListUnitsByPatterns", "asas", "a(ssssssouso)", FakeSystemd::onListUnits, 0),
+  SD_BUS_METHOD("ListUnitFilesByPatterns", "asas", "a(ss)", FakeSystemd::onListUnitFiles, 0),
+  SD_BUS_METHOD("GetUnitFileState", "s", "s", FakeSystemd::onGetUnitFileState, 0),
+  SD_BUS_METHOD("EnableUnitFiles", "asbb", "ba(sss)", FakeSystemd::onEnableUnitFiles, 0),
+  SD_BUS_METHOD("DisableUnitFiles", "asb", "a(sss)", FakeSystemd::onDisableUnitFiles, 0),
+  SD_BUS_METHOD("StartUnit", "ss", "o", FakeSystemd::onStartUnit, 0),
+  SD_BUS_METHOD("StopUnit", "ss", "o", FakeSystemd::onStopUnit, 0),
+  SD_BUS_VTABLE_END
+};
+
+const sd_bus_vtable FakeSystemd::unitVtable[] = {
+  SD_BUS_VTABLE_START(0),
+  SD_BUS_PROPERTY("Description", "s", FakeSystemd::onGetProperty, 0, 0),
+  SD_BUS_PROPERTY("SubState", "s", FakeSystemd::onGetProperty, 0, 0),
+  SD_BUS_VTABLE_END
+};
+
+FakeSystemd::FakeSystemd(int size, int latency) {
+  static const char *types[] = { "service", "socket", "timer", "mount", "path" };
+  static const char *states[] = { "enabled", "disabled", "static" };
+  char id[64];
+
+  this->latency = latency;
+  running = false;
+
+  for (int i = 0; i < size; i++) {
+    FakeUnit unit;
+
+    unit.loaded = i % 2 == 0;
+    unit.hasFile = i % 20 != 0;
+
+    if (unit.hasFile) {
+      snprintf(id, sizeof(id), "fake-%d.%s", i, types[i % 5]);
+    } else {
+      snprintf(id, sizeof(id), "fake-dev%d.device", i);
+    }
+
+    unit.id = id;
+    unit.description = "Fake unit " + std::to_string(i);
+    unit.state = unit.hasFile ? states[i % 3] : "";
+    unit.sub = unit.loaded && i % 4 == 0 ? "running" : "dead";
+
+    index[unit.id] = units.size();
+    units.push_back(unit);
+  }
+
+  addUnit(FAKE_SSH_UNIT, "enabled");
+  units.back().sub = "running";
+  signals.clear();
+}
+
+FakeSystemd::~FakeSystemd() {
+  stop();
+}
+
+void FakeSystemd::start() {
+  char dir[] = "/tmp/chkservice-fake-XXXXXX";
+  struct sockaddr_un sa;
+
+  if (running) {
+    return;
+  }
+
+  if (mkdtemp(dir) == NULL) {
+    throw std::string("fake systemd: can not create socket directory");
+  }
+
+  directory = dir;
+  std::string path = directory + "/bus";
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (listenFd < 0 || bind(listenFd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      listen(listenFd, 16) < 0) {
+    throw std::string("fake systemd: can not listen on ") + path;
+  }
+
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  const char *previous = getenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+  hadAddress = previous != NULL;
+  previousAddress = hadAddress ? previous : "";
+  address = "unix:path=" + path;
+  setenv("DBUS_SYSTEM_BUS_ADDRESS", address.c_str(), 1);
+
+  /*
+   * Nobody listened to changes made while stopped, a signal sent
+   * before the reply to Hello breaks the connection
+   */
+  signals.clear();
+  running = true;
+  server = std::thread(&FakeSystemd::run, this);
+}
+
+void FakeSystemd::stop() {
+  if (!running) {
+    return;
+  }
+
+  running = false;
+  notify(wakeFd);
+
+  server.join();
+
+  close(listenFd);
+  close(wakeFd);
+  listenFd = -1;
+  wakeFd = -1;
+
+  unlink((directory + "/bus").c_str());
+  rmdir(directory.c_str());
+
+  if (hadAddress) {
+    setenv("DBUS_SYSTEM_BUS_ADDRESS", previousAddress.c_str(), 1);
+  } else {
+    unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+  }
+}
+
+/*
+ * Serves every connection from one thread, the way systemd does
+ */
+void FakeSystemd::run() {
+  std::vector<struct pollfd> fds;
+  uint64_t wake;
+
+  while (running) {
+    fds.clear();
+    fds.push_back({ wakeFd, POLLIN, 0 });
+    fds.push_back({ listenFd, POLLIN, 0 });
+
+    for (auto bus : connections) {
+      fds.push_back({ sd_bus_get_fd(bus), (short)sd_bus_get_events(bus), 0 });
+    }
+
+    if (poll(fds.data(), fds.size(), 100) < 0) {
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      if (read(wakeFd, &wake, sizeof(wake)) < 0) {
+        wake = 0;
+      }
+    }
+
+    if (fds[1].revents & POLLIN) {
+      accept();
+    }
+
+    for (size_t i = 0; i < connections.size();) {
+      int status;
+
+      while ((status = sd_bus_process(connections[i], NULL)) > 0) {
+        continue;
+      }
+
+      if (status < 0) {
+        sd_bus_flush_close_unref(connections[i]);
+        connections.erase(connections.begin() + i);
+      } else {
+        i++;
+      }
+    }
+
+    emitPending();
+  }
+
+  for (auto bus : connections) {
+    sd_bus_flush_close_unref(bus);
+  }
+
+  connections.clear();
+}
+
+void FakeSystemd::accept() {
+  sd_bus *bus = NULL;
+  sd_id128_t id;
+  int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+  if (fd < 0) {
+    return;
+  }
+
+  sd_id128_randomize(&id);
+
+  if (sd_bus_new(&bus) < 0) {
+    close(fd);
+    return;
+  }
+
+  /*
+   * Replies and signals look like they come from systemd,
+   * the matches of ChkBus filter on that
+   */
+  if (sd_bus_set_fd(bus, fd, fd) < 0 ||
+      sd_bus_set_server(bus, 1, id) < 0 ||
+      sd_bus_set_anonymous(bus, 1) < 0 ||
+      sd_bus_set_sender(bus, "org.freedesktop.systemd1") < 0 ||
+      sd_bus_add_object_vtable(bus, NULL, "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", driverVtable, this) < 0 ||
+      sd_bus_add_object_vtable(bus, NULL, FAKE_MANAGER_PATH,
+        FAKE_MANAGER_INTERFACE, managerVtable, this) < 0 ||
+      sd_bus_add_fallback_vtable(bus, NULL, FAKE_UNIT_PREFIX,
+        "org.freedesktop.systemd1.Unit", unitVtable, onFindUnit, this) < 0 ||
+      sd_bus_add_filter(bus, NULL, onUnitCall, this) < 0 ||
+      sd_bus_start(bus) < 0) {
+    sd_bus_flush_close_unref(bus);
+    return;
+  }
+
+  connections.push_back(bus);
+}
+
+int FakeSystemd::loadedCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  int count = 0;
+
+  for (auto &unit : units) {
+    count += unit.loaded;
+  }
+
+  return count;
+}
+
+int FakeSystemd::filesCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  int count = 0;
+
+  for (auto &unit : units) {
+    count += unit.hasFile;
+  }
+
+  return count;
+}
+
+int FakeSystemd::unitsCount() {
+  std::lock_guard<std::mutex> guard(lock);
+
+  return units.size();
+}
+
+unsigned long FakeSystemd::getCalls(const char *member) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto found = calls.find(member);
+
+  return found == calls.end() ? 0 : found->second;
+}
+
+FakeUnit FakeSystemd::getUnit(const char *id) {
+  std::lock_guard<std::mutex> guard(lock);
+  FakeUnit *unit = findUnit(id);
+
+  return unit == NULL ? FakeUnit() : *unit;
+}
+
+/*
+ * A unit file installed and loaded while the fake runs
+ */
+void FakeSystemd::addUnit(const char *id, const char *state) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    FakeUnit unit;
+
+    unit.id = id;
+    unit.description = std::string("Fake ") + id;
+    unit.state = state;
+    unit.sub = "dead";
+    unit.hasFile = state[0] != 0;
+    unit.loaded = true;
+
+    index[unit.id] = units.size();
+    units.push_back(unit);
+    signals.push_back({ "UnitNew", id });
+  }
+
+  if (running) {
+    notify(wakeFd);
+  }
+}
+
+void FakeSystemd::removeUnit(const char *id) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    FakeUnit *unit = findUnit(id);
+
+    if (unit == NULL) {
+      return;
+    }
+
+    unit->loaded = false;
+    unit->sub = "dead";
+    signals.push_back({ "UnitRemoved", id });
+  }
+
+  if (running) {
+    notify(wakeFd);
+  }
+}
+
+/*
+ * Calls on the unit object are taken and never answered, like a unit
+ * systemd hangs on
+ */
+void FakeSystemd::silenceUnit(const char *id) {
+  std::lock_guard<std::mutex> guard(lock);
+  FakeUnit *unit = findUnit(id);
+
+  if (unit != NULL) {
+    unit->silent = true;
+  }
+}
+
+FakeUnit *FakeSystemd::findUnit(const char *id) {
+  auto found = index.find(id);
+
+  return found == index.end() ? NULL : &units[found->second];
+}
+
+void FakeSystemd::emitPending() {
+  std::vector<FakeSignal> pending;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.swap(signals);
+  }
+
+  for (auto &signal : pending) {
+    emitSignal(signal);
+  }
+}
+
+/*
+ * Signals go to every connection, as if all of them had subscribed
+ */
+void FakeSystemd::emitSignal(const FakeSignal &signal) {
+  char *path = NULL;
+
+  if (sd_bus_path_encode(FAKE_UNIT_PREFIX, signal.id.c_str(), &path) < 0) {
+    return;
+  }
+
+  for (auto bus : connections) {
+    if (signal.member == "UnitFilesChanged") {
+      sd_bus_emit_signal(bus, FAKE_MANAGER_PATH, FAKE_MANAGER_INTERFACE,
+          "UnitFilesChanged", NULL);
+    } else {
+      sd_bus_emit_signal(bus, FAKE_MANAGER_PATH, FAKE_MANAGER_INTERFACE,
+          signal.member.c_str(), "so", signal.id.c_str(), path);
+    }
+  }
+
+  free(path);
+}
+
+/*
+ * What systemd sends when a job is done: the job is removed and
+ * the unit reports its new sub state
+ */
+void FakeSystemd::emitSubState(const FakeUnit &unit, unsigned int job) {
+  char *path = NULL;
+  char jobPath[64];
+
+  if (sd_bus_path_encode(FAKE_UNIT_PREFIX, unit.id.c_str(), &path) < 0) {
+    return;
+  }
+
+  snprintf(jobPath, sizeof(jobPath), FAKE_MANAGER_PATH "/job/%u", job);
+
+  for (auto bus : connections) {
+    sd_bus_message *message = NULL;
+
+    sd_bus_emit_signal(bus, FAKE_MANAGER_PATH, FAKE_MANAGER_INTERFACE,
+        "JobRemoved", "uoss", job, jobPath, unit.id.c_str(), "done");
+
+    if (sd_bus_message_new_signal(bus, &message, path,
+          "org.freedesktop.DBus.Properties", "PropertiesChanged") < 0) {
+      continue;
+    }
+
+    if (sd_bus_message_append(message, "sa{sv}as", "org.freedesktop.systemd1.Unit",
+          1, "SubState", "s", unit.sub.c_str(), 0) >= 0) {
+      sd_bus_send(bus, message, NULL);
+    }
+
+    sd_bus_message_unref(message);
+  }
+
+  free(path);
+}
+
+/*
+ * Counts the call and makes the caller wait as long as configured
+ */
+void FakeSystemd::enter(sd_bus_message *message) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    calls[sd_bus_message_get_member(message)]++;
+  }
+
+  if (latency > 0) {
+    usleep(latency);
+  }
+}
+
+/*
+ * States and patterns of the *ByPatterns methods, plain list
+ * methods have none and match every unit
+ */
+int FakeSystemd::readFilter(sd_bus_message *message, FakeFilter *filter) {
+  const char *value;
+  int status;
+
+  if (strstr(sd_bus_message_get_member(message), "ByPatterns") == NULL) {
+    return 0;
+  }
+
+  for (auto list : { &filter->states, &filter->patterns }) {
+    status = sd_bus_message_enter_container(message, SD_BUS_TYPE_ARRAY, "s");
+
+    while (status >= 0 && (status = sd_bus_message_read(message, "s", &value)) > 0) {
+      list->push_back(value);
+    }
+
+    if (status >= 0) {
+      status = sd_bus_message_exit_container(message);
+    }
+
+    if (status < 0) {
+      return status;
+    }
+  }
+
+  return 0;
+}
+
+bool FakeSystemd::matchFilter(const FakeFilter &filter, const std::string &id,
+    std::initializer_list<const char *> states) {
+  bool found = filter.states.empty();
+
+  for (auto &state : filter.states) {
+    for (auto value : states) {
+      found = found || state == value;
+    }
+  }
+
+  if (!found) {
+    return false;
+  }
+
+  for (auto &pattern : filter.patterns) {
+    if (fnmatch(pattern.c_str(), id.c_str(), FNM_NOESCAPE) == 0) {
+      return true;
+    }
+  }
+
+  return filter.patterns.empty();
+}
+
+int FakeSystemd::onHello(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  return sd_bus_reply_method_return(message, "s", ":1.1");
+}
+
+int FakeSystemd::onMatch(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  return sd_bus_reply_method_return(message, "");
+}
+
+int FakeSystemd::onEmpty(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  ((FakeSystemd *)userdata)->enter(message);
+
+  return sd_bus_reply_method_return(message, "");
+}
+
+int FakeSystemd::onListUnits(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  sd_bus_message *reply = NULL;
+  FakeFilter filter;
+  int status;
+
+  fake->enter(message);
+
+  status = readFilter(message, &filter);
+
+  if (status < 0) {
+    return status;
+  }
+
+  std::lock_guard<std::mutex> guard(fake->lock);
+
+  status = sd_bus_message_new_method_return(message, &reply);
+
+  if (status >= 0) {
+    status = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
+  }
+
+  for (size_t i = 0; status >= 0 && i < fake->units.size(); i++) {
+    const FakeUnit &unit = fake->units[i];
+    const char *active = unit.sub == "running" ? "active" : "inactive";
+    char *path = NULL;
+
+    if (!unit.loaded ||
+        !matchFilter(filter, unit.id, { "loaded", active, unit.sub.c_str() })) {
+      continue;
+    }
+
+    status = sd_bus_path_encode(FAKE_UNIT_PREFIX, unit.id.c_str(), &path);
+
+    if (status >= 0) {
+      status = sd_bus_message_append(reply, "(ssssssouso)",
+        unit.id.c_str(),
+        unit.description.c_str(),
+        "loaded",
+        active,
+        unit.sub.c_str(),
+        "",
+        path,
+        0,
+        "",
+        "/");
+    }
+
+    free(path);
+  }
+
+  if (status >= 0) {
+    status = sd_bus_message_close_container(reply);
+  }
+
+  if (status >= 0) {
+    status = sd_bus_send(NULL, reply, NULL);
+  }
+
+  sd_bus_message_unref(reply);
+
+  return status;
+}
+
+int FakeSystemd::onListUnitFiles(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  sd_bus_message *reply = NULL;
+  FakeFilter filter;
+  std::string path;
+  int status;
+
+  fake->enter(message);
+
+  status = readFilter(message, &filter);
+
+  if (status < 0) {
+    return status;
+  }
+
+  std::lock_guard<std::mutex> guard(fake->lock);
+
+  status = sd_bus_message_new_method_return(message, &reply);
+
+  if (status >= 0) {
+    status = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "(ss)");
+  }
+
+  for (size_t i = 0; status >= 0 && i < fake->units.size(); i++) {
+    const FakeUnit &unit = fake->units[i];
+
+    if (!unit.hasFile || !matchFilter(filter, unit.id, { unit.state.c_str() })) {
+      continue;
+    }
+
+    path = "/lib/systemd/system/" + unit.id;
+    status = sd_bus_message_append(reply, "(ss)", path.c_str(), unit.state.c_str());
+  }
+
+  if (status >= 0) {
+    status = sd_bus_message_close_container(reply);
+  }
+
+  if (status >= 0) {
+    status = sd_bus_send(NULL, reply, NULL);
+  }
+
+  sd_bus_message_unref(reply);
+
+  return status;
+}
+
+int FakeSystemd::onGetUnitFileState(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  const char *id = NULL;
+  int status;
+
+  fake->enter(message);
+
+  status = sd_bus_message_read(message, "s", &id);
+
+  if (status < 0) {
+    return status;
+  }
+
+  std::lock_guard<std::mutex> guard(fake->lock);
+  FakeUnit *unit = fake->findUnit(id);
+
+  if (unit == NULL || !unit->hasFile) {
+    return sd_bus_reply_method_errorf(message, "org.freedesktop.DBus.Error.FileNotFound",
+        "No such file or directory");
+  }
+
+  return sd_bus_reply_method_return(message, "s", unit->state.c_str());
+}
+
+int FakeSystemd::onEnableUnitFiles(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  char **ids = NULL;
+  int status;
+
+  fake->enter(message);
+
+  status = sd_bus_message_read_strv(message, &ids);
+
+  if (status < 0) {
+    return status;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(fake->lock);
+
+    for (int i = 0; ids[i] != NULL; i++) {
+      FakeUnit *unit = fake->findUnit(ids[i]);
+
+      if (unit != NULL && unit->hasFile) {
+        unit->state = "enabled";
+      }
+
+      free(ids[i]);
+    }
+
+    free(ids);
+  }
+
+  status = sd_bus_reply_method_return(message, "ba(sss)", 0, 0);
+  fake->emitSignal({ "UnitFilesChanged", "" });
+
+  return status;
+}
+
+int FakeSystemd::onDisableUnitFiles(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  char **ids = NULL;
+  int status;
+
+  fake->enter(message);
+
+  status = sd_bus_message_read_strv(message, &ids);
+
+  if (status < 0) {
+    return status;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(fake->lock);
+
+    for (int i = 0; ids[i] != NULL; i++) {
+      FakeUnit *unit = fake->findUnit(ids[i]);
+
+      if (unit != NULL && unit->hasFile && unit->state == "enabled") {
+        unit->state = "disabled";
+      }
+
+      free(ids[i]);
+    }
+
+    free(ids);
+  }
+
+  status = sd_bus_reply_method_return(message, "a(sss)", 0);
+  fake->emitSignal({ "UnitFilesChanged", "" });
+
+  return status;
+}
+
+/*
+ * Start and stop finish at once: the unit gets its new sub state,
+ * the job path is returned and the job is reported done
+ */
+int FakeSystemd::runJob(sd_bus_message *message, const char *sub) {
+  const char *id = NULL;
+  const char *mode = NULL;
+  FakeUnit unit;
+  unsigned int job;
+  char jobPath[64];
+  int status;
+
+  enter(message);
+
+  status = sd_bus_message_read(message, "ss", &id, &mode);
+
+  if (status < 0) {
+    return status;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    FakeUnit *found = findUnit(id);
+
+    if (found == NULL) {
+      return sd_bus_reply_method_errorf(message, "org.freedesktop.systemd1.NoSuchUnit",
+          "Unit %s not found.", id);
+    }
+
+    found->loaded = true;
+    found->sub = sub;
+    unit = *found;
+    job = ++jobs;
+  }
+
+  snprintf(jobPath, sizeof(jobPath), FAKE_MANAGER_PATH "/job/%u", job);
+  status = sd_bus_reply_method_return(message, "o", jobPath);
+  emitSubState(unit, job);
+
+  return status;
+}
+
+int FakeSystemd::onStartUnit(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  return ((FakeSystemd *)userdata)->runJob(message, "running");
+}
+
+int FakeSystemd::onStopUnit(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  return ((FakeSystemd *)userdata)->runJob(message, "dead");
+}
+
+/*
+ * Swallows method calls on silent units, they are counted still
+ */
+int FakeSystemd::onUnitCall(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  const char *path = sd_bus_message_get_path(message);
+  char *id = NULL;
+  bool silent = false;
+
+  if (path != NULL && sd_bus_message_is_method_call(message, NULL, NULL) &&
+      sd_bus_path_decode(path, FAKE_UNIT_PREFIX, &id) > 0) {
+    std::lock_guard<std::mutex> guard(fake->lock);
+    FakeUnit *unit = fake->findUnit(id);
+
+    silent = unit != NULL && unit->silent;
+
+    if (silent) {
+      fake->calls[sd_bus_message_get_member(message)]++;
+    }
+  }
+
+  free(id);
+
+  return silent ? 1 : 0;
+}
+
+int FakeSystemd::onFindUnit(sd_bus *bus, const char *path, const char *interface,
+    void *userdata, void **found, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  char *id = NULL;
+  bool exists;
+
+  if (sd_bus_path_decode(path, FAKE_UNIT_PREFIX, &id) <= 0) {
+    return 0;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(fake->lock);
+    exists = fake->findUnit(id) != NULL;
+  }
+
+  free(id);
+  *found = fake;
+
+  return exists ? 1 : 0;
+}
+
+/*
+ * Reads of unit properties are counted by property name
+ */
+int FakeSystemd::onGetProperty(sd_bus *bus, const char *path, const char *interface,
+    const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+  FakeSystemd *fake = (FakeSystemd *)userdata;
+  bool description = strcmp(property, "Description") == 0;
+  std::string value = description ? "" : "dead";
+  char *id = NULL;
+
+  if (sd_bus_path_decode(path, FAKE_UNIT_PREFIX, &id) > 0) {
+    std::lock_guard<std::mutex> guard(fake->lock);
+    FakeUnit *unit = fake->findUnit(id);
+
+    fake->calls[property]++;
+
+    if (unit != NULL) {
+      value = description ? unit->description : unit->sub;
+    }
+  }
+
+  free(id);
+
+  return sd_bus_message_append(reply, "s", value.c_str());
+}
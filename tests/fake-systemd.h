@@ -0,0 +1,144 @@
+/*
+ *    chkservice is a tool for managing systemd units.
+ *    more infomration at https://github.com/linuxenko/chkservice
+ *
+ *    Copyright (C) 2017 Svetlana Linuxenko
+ *
+ *    chkservice program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    chkservice program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FAKE_SYSTEMD_H
+#define _FAKE_SYSTEMD_H
+
+#include <atomic>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <systemd/sd-bus.h>
+
+/*
+ * Id every fake has, it is enabled and running
+ */
+#define FAKE_SSH_UNIT "ssh.service"
+
+typedef struct FakeUnit {
+  std::string id;
+  std::string description;
+  std::string state;
+  std::string sub;
+  bool hasFile;
+  bool loaded;
+  bool silent = false;
+} FakeUnit;
+
+/*
+ * States and name patterns of a *ByPatterns call, empty lists match all
+ */
+typedef struct FakeFilter {
+  std::vector<std::string> states;
+  std::vector<std::string> patterns;
+} FakeFilter;
+
+typedef struct FakeSignal {
+  std::string member;
+  std::string id;
+} FakeSignal;
+
+/*
+ * Stand-in for systemd on a private unix socket.
+ * start() points DBUS_SYSTEM_BUS_ADDRESS at the socket, so every ChkBus
+ * opened until stop() talks to the fake instead of the system bus. The
+ * Manager methods ChkBus calls and the signals it listens to are served
+ * from a thread of its own, each method call sleeps latency microseconds
+ * first, like a busy systemd would. Unit properties are served too,
+ * getCalls counts their reads by property name.
+ *
+ * The unit set is size synthetic units of a few types. Every other unit
+ * is loaded, every tenth loaded unit has no unit file, and ssh.service
+ * is always there.
+ */
+class FakeSystemd {
+  public:
+    FakeSystemd(int size, int latency = 0);
+    ~FakeSystemd();
+
+    void start();
+    void stop();
+
+    int loadedCount();
+    int filesCount();
+    int unitsCount();
+    unsigned long getCalls(const char *member);
+    FakeUnit getUnit(const char *id);
+
+    void addUnit(const char *id, const char *state);
+    void removeUnit(const char *id);
+    void silenceUnit(const char *id);
+
+  private:
+    std::vector<FakeUnit> units;
+    std::unordered_map<std::string, size_t> index;
+    std::map<std::string, unsigned long> calls;
+    std::vector<sd_bus *> connections;
+    std::vector<FakeSignal> signals;
+    std::mutex lock;
+    std::thread server;
+    std::atomic<bool> running;
+    std::string directory;
+    std::string address;
+    std::string previousAddress;
+    bool hadAddress = false;
+    int latency;
+    int listenFd = -1;
+    int wakeFd = -1;
+    unsigned int jobs = 0;
+
+    void run();
+    void accept();
+    void emitPending();
+    void emitSignal(const FakeSignal &signal);
+    void emitSubState(const FakeUnit &unit, unsigned int job);
+    void enter(sd_bus_message *message);
+    int runJob(sd_bus_message *message, const char *sub);
+    FakeUnit *findUnit(const char *id);
+
+    static int readFilter(sd_bus_message *message, FakeFilter *filter);
+    static bool matchFilter(const FakeFilter &filter, const std::string &id,
+        std::initializer_list<const char *> states);
+    static int onHello(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onMatch(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onEmpty(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onListUnits(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onListUnitFiles(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onGetUnitFileState(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onEnableUnitFiles(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onDisableUnitFiles(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onStartUnit(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onStopUnit(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onUnitCall(sd_bus_message *message, void *userdata, sd_bus_error *error);
+    static int onFindUnit(sd_bus *bus, const char *path, const char *interface,
+        void *userdata, void **found, sd_bus_error *error);
+    static int onGetProperty(sd_bus *bus, const char *path, const char *interface,
+        const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error);
+
+    static const sd_bus_vtable driverVtable[];
+    static const sd_bus_vtable managerVtable[];
+    static const sd_bus_vtable unitVtable[];
+};
+
+#endif